@@ -0,0 +1,182 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replaces the global allocation functions, including the nothrow and aligned forms, to count allocations.
+// Kept in its own translation unit so the compiler never sees the replacement and its callers together.
+
+#include "allocation_counter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+static atomic<uint64_t> allocation_count(0);
+static atomic<uint64_t> allocated_bytes(0);
+
+uint64_t get_allocation_count()
+{
+	return allocation_count;
+}
+
+uint64_t get_allocated_bytes()
+{
+	return allocated_bytes;
+}
+
+static void *counted_malloc(size_t size)
+{
+	allocation_count++;
+	allocated_bytes += size;
+	return malloc(size ? size : 1);
+}
+
+void *operator new(size_t size)
+{
+	void *ptr = counted_malloc(size);
+	if (!ptr)
+		throw bad_alloc();
+	return ptr;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept
+{
+	return counted_malloc(size);
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept
+{
+	return counted_malloc(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, const nothrow_t &) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr, const nothrow_t &) noexcept
+{
+	free(ptr);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+	free(ptr);
+}
+#endif
+
+#ifdef __cpp_aligned_new
+// Over-aligned types are only allocated through these when building as C++17 or later.
+static void *counted_aligned_malloc(size_t size, align_val_t alignment)
+{
+	allocation_count++;
+	allocated_bytes += size;
+#ifdef _WIN32
+	return _aligned_malloc(size ? size : 1, size_t(alignment));
+#else
+	void *ptr = nullptr;
+	if (posix_memalign(&ptr, size_t(alignment), size ? size : 1) != 0)
+		return nullptr;
+	return ptr;
+#endif
+}
+
+static void aligned_free(void *ptr)
+{
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+void *operator new(size_t size, align_val_t alignment)
+{
+	void *ptr = counted_aligned_malloc(size, alignment);
+	if (!ptr)
+		throw bad_alloc();
+	return ptr;
+}
+
+void *operator new[](size_t size, align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void *operator new(size_t size, align_val_t alignment, const nothrow_t &) noexcept
+{
+	return counted_aligned_malloc(size, alignment);
+}
+
+void *operator new[](size_t size, align_val_t alignment, const nothrow_t &) noexcept
+{
+	return counted_aligned_malloc(size, alignment);
+}
+
+void operator delete(void *ptr, align_val_t) noexcept
+{
+	aligned_free(ptr);
+}
+
+void operator delete[](void *ptr, align_val_t) noexcept
+{
+	aligned_free(ptr);
+}
+
+void operator delete(void *ptr, align_val_t, const nothrow_t &) noexcept
+{
+	aligned_free(ptr);
+}
+
+void operator delete[](void *ptr, align_val_t, const nothrow_t &) noexcept
+{
+	aligned_free(ptr);
+}
+
+void operator delete(void *ptr, size_t, align_val_t) noexcept
+{
+	aligned_free(ptr);
+}
+
+void operator delete[](void *ptr, size_t, align_val_t) noexcept
+{
+	aligned_free(ptr);
+}
+#endif
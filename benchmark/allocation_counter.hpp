@@ -0,0 +1,26 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_ALLOCATION_COUNTER_HPP
+#define SPIRV_CROSS_ALLOCATION_COUNTER_HPP
+
+#include <stdint.h>
+
+// Totals over every operator new call made by the process so far.
+uint64_t get_allocation_count();
+uint64_t get_allocated_bytes();
+
+#endif
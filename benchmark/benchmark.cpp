@@ -0,0 +1,362 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures parse, reflection and compile throughput of every backend over a corpus of binary SPIR-V modules.
+// Usage: spirv-cross-benchmark [--iterations N] [--output results.json] [directory or file.spv]...
+// Without inputs, the checked-in corpus in benchmark/corpus is used.
+
+#include "allocation_counter.hpp"
+#include "spirv_cpp.hpp"
+#include "spirv_msl.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
+
+#ifndef SPIRV_CROSS_BENCHMARK_CORPUS
+#define SPIRV_CROSS_BENCHMARK_CORPUS "benchmark/corpus"
+#endif
+
+using namespace spv;
+using namespace spirv_cross;
+using namespace std;
+
+struct Module
+{
+	string name;
+	vector<uint32_t> spirv;
+};
+
+struct PhaseResult
+{
+	string name;
+	string error;
+	double median_us = 0.0;
+	double p99_us = 0.0;
+	uint64_t allocations = 0;
+	uint64_t allocated_bytes = 0;
+};
+
+static bool read_module(const string &path, Module &module)
+{
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	long len = ftell(file);
+	rewind(file);
+
+	bool ok = len > 0 && (len % sizeof(uint32_t)) == 0;
+	if (ok)
+	{
+		module.spirv.resize(size_t(len) / sizeof(uint32_t));
+		ok = fread(module.spirv.data(), sizeof(uint32_t), module.spirv.size(), file) == module.spirv.size();
+	}
+	fclose(file);
+
+	// Either endianness of the magic number is accepted by the parser.
+	ok = ok && (module.spirv[0] == MagicNumber || module.spirv[0] == 0x03022307u);
+	module.name = path;
+	return ok;
+}
+
+static bool has_spv_extension(const string &path)
+{
+	return path.size() > 4 && path.compare(path.size() - 4, 4, ".spv") == 0;
+}
+
+static void collect_modules(const string &path, vector<Module> &modules)
+{
+#ifdef _WIN32
+	DWORD attributes = GetFileAttributesA(path.c_str());
+	bool is_directory = attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat st;
+	bool is_directory = stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+
+	if (!is_directory)
+	{
+		Module module;
+		if (read_module(path, module))
+			modules.push_back(move(module));
+		else
+			fprintf(stderr, "Skipping %s, not a SPIR-V module.\n", path.c_str());
+		return;
+	}
+
+	vector<string> entries;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE handle = FindFirstFileA((path + "\\*").c_str(), &data);
+	if (handle != INVALID_HANDLE_VALUE)
+	{
+		do
+			entries.push_back(data.cFileName);
+		while (FindNextFileA(handle, &data));
+		FindClose(handle);
+	}
+#else
+	DIR *dir = opendir(path.c_str());
+	if (dir)
+	{
+		while (auto *entry = readdir(dir))
+			entries.push_back(entry->d_name);
+		closedir(dir);
+	}
+#endif
+
+	// Keep the order stable so runs can be compared.
+	sort(begin(entries), end(entries));
+	for (auto &entry : entries)
+	{
+		if (entry == "." || entry == "..")
+			continue;
+
+		string child = path + "/" + entry;
+#ifdef _WIN32
+		bool child_is_directory = (GetFileAttributesA(child.c_str()) & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+		bool child_is_directory = stat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+		if (child_is_directory || has_spv_extension(entry))
+			collect_modules(child, modules);
+	}
+}
+
+static uint64_t get_peak_rss_kb()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return uint64_t(counters.PeakWorkingSetSize) / 1024;
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	// Reported in bytes rather than kilobytes.
+	return uint64_t(usage.ru_maxrss) / 1024;
+#else
+	return uint64_t(usage.ru_maxrss);
+#endif
+#endif
+}
+
+// Runs prepare() untimed and then run() timed, iterations times.
+// Allocation counts are taken from the first iteration, they do not vary between runs.
+static PhaseResult measure(const char *name, unsigned iterations, const function<void()> &prepare,
+                           const function<void()> &run)
+{
+	PhaseResult result;
+	result.name = name;
+
+	vector<double> samples;
+	samples.reserve(iterations);
+
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+	try
+#endif
+	{
+		for (unsigned i = 0; i < iterations; i++)
+		{
+			prepare();
+
+			uint64_t count = get_allocation_count();
+			uint64_t bytes = get_allocated_bytes();
+			auto start = chrono::steady_clock::now();
+			run();
+			auto end = chrono::steady_clock::now();
+
+			if (i == 0)
+			{
+				result.allocations = get_allocation_count() - count;
+				result.allocated_bytes = get_allocated_bytes() - bytes;
+			}
+			samples.push_back(chrono::duration<double, micro>(end - start).count());
+		}
+	}
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+	catch (const exception &e)
+	{
+		result.error = e.what();
+		return result;
+	}
+#endif
+
+	sort(begin(samples), end(samples));
+	result.median_us = samples[samples.size() / 2];
+	result.p99_us = samples[min(samples.size() - 1, size_t(samples.size() * 0.99))];
+	return result;
+}
+
+template <typename T>
+static PhaseResult measure_backend(const char *name, unsigned iterations, const ParsedIR &ir)
+{
+	// Copying the parsed module and constructing the backend are left out of the timing.
+	unique_ptr<T> compiler;
+	return measure(name, iterations, [&] { compiler.reset(new T(ir)); }, [&] { compiler->compile(); });
+}
+
+static string json_string(const string &str)
+{
+	string ret = "\"";
+	for (auto c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			ret += '\\';
+			ret += c;
+		}
+		else if (uint8_t(c) < 0x20)
+		{
+			char buf[8];
+			sprintf(buf, "\\u%04x", unsigned(uint8_t(c)));
+			ret += buf;
+		}
+		else
+			ret += c;
+	}
+	return ret + "\"";
+}
+
+static void print_phase(FILE *file, const PhaseResult &phase, bool last)
+{
+	fprintf(file, "\t\t\t\t%s: { ", json_string(phase.name).c_str());
+	if (!phase.error.empty())
+		fprintf(file, "\"error\": %s", json_string(phase.error).c_str());
+	else
+	{
+		fprintf(file, "\"median_us\": %.3f, \"p99_us\": %.3f, \"allocations\": %llu, \"allocated_bytes\": %llu",
+		        phase.median_us, phase.p99_us, static_cast<unsigned long long>(phase.allocations),
+		        static_cast<unsigned long long>(phase.allocated_bytes));
+	}
+	fprintf(file, " }%s\n", last ? "" : ",");
+}
+
+static void print_help()
+{
+	fprintf(stderr, "Usage: spirv-cross-benchmark [--iterations N] [--output results.json] [directory or file.spv]...\n");
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned iterations = 50;
+	const char *output = nullptr;
+	vector<string> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+			iterations = unsigned(max(1, atoi(argv[++i])));
+		else if (!strcmp(argv[i], "--output") && i + 1 < argc)
+			output = argv[++i];
+		else if (!strcmp(argv[i], "--help"))
+		{
+			print_help();
+			return EXIT_SUCCESS;
+		}
+		else if (argv[i][0] == '-')
+		{
+			print_help();
+			return EXIT_FAILURE;
+		}
+		else
+			inputs.push_back(argv[i]);
+	}
+
+	if (inputs.empty())
+		inputs.push_back(SPIRV_CROSS_BENCHMARK_CORPUS);
+
+	vector<Module> modules;
+	for (auto &input : inputs)
+		collect_modules(input, modules);
+
+	if (modules.empty())
+	{
+		fprintf(stderr, "No SPIR-V modules found.\n");
+		return EXIT_FAILURE;
+	}
+
+	FILE *file = output ? fopen(output, "w") : stdout;
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open %s for writing.\n", output);
+		return EXIT_FAILURE;
+	}
+
+	const char *phase_names[] = { "parse", "reflection", "glsl", "msl", "cpp" };
+	const size_t phase_count = sizeof(phase_names) / sizeof(phase_names[0]);
+	double total_median_us[phase_count] = {};
+
+	fprintf(file, "{\n\t\"iterations\": %u,\n\t\"modules\": [\n", iterations);
+	for (auto &module : modules)
+	{
+		vector<PhaseResult> phases;
+		unique_ptr<Compiler> parsed;
+
+		phases.push_back(measure("parse", iterations, [&] { parsed.reset(); },
+		                         [&] { parsed.reset(new Compiler(module.spirv.data(), module.spirv.size())); }));
+
+		if (parsed)
+		{
+			phases.push_back(measure("reflection", iterations, [] {}, [&] {
+				parsed->get_shader_resources();
+				parsed->get_active_interface_variables();
+			}));
+
+			auto &ir = parsed->get_parsed_ir();
+			phases.push_back(measure_backend<CompilerGLSL>("glsl", iterations, ir));
+			phases.push_back(measure_backend<CompilerMSL>("msl", iterations, ir));
+			phases.push_back(measure_backend<CompilerCPP>("cpp", iterations, ir));
+		}
+
+		for (size_t i = 0; i < phases.size(); i++)
+			if (phases[i].error.empty())
+				total_median_us[i] += phases[i].median_us;
+
+		fprintf(file, "\t\t{\n\t\t\t\"name\": %s,\n\t\t\t\"words\": %llu,\n\t\t\t\"phases\": {\n",
+		        json_string(module.name).c_str(), static_cast<unsigned long long>(module.spirv.size()));
+		for (size_t i = 0; i < phases.size(); i++)
+			print_phase(file, phases[i], i + 1 == phases.size());
+		fprintf(file, "\t\t\t}\n\t\t}%s\n", &module == &modules.back() ? "" : ",");
+	}
+
+	fprintf(file, "\t],\n\t\"total_median_us\": { ");
+	for (size_t i = 0; i < phase_count; i++)
+		fprintf(file, "\"%s\": %.3f%s", phase_names[i], total_median_us[i], i + 1 == phase_count ? "" : ", ");
+	fprintf(file, " },\n\t\"peak_rss_kb\": %llu\n}\n", static_cast<unsigned long long>(get_peak_rss_kb()));
+
+	if (output)
+		fclose(file);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+
+# Rebuilds the binary SPIR-V corpus used by spirv-cross-benchmark from the shaders/ test folder.
+# GLSL sources are compiled with glslangValidator and assembly sources with spirv-as.
+# Both tools are required, unless --allow-partial is given, in which case shaders which
+# cannot be built with the tools at hand are skipped with a warning.
+
+import sys
+import os
+import shutil
+import subprocess
+import argparse
+import collections
+
+def is_spirv_assembly(shader):
+    return '.asm.' in shader
+
+def build_shader(shader, output):
+    if is_spirv_assembly(shader):
+        subprocess.check_call(['spirv-as', '-o', output, shader])
+    else:
+        subprocess.check_call(['glslangValidator', '-V', '-o', output, shader], stdout = subprocess.DEVNULL)
+
+def shader_stage(shader):
+    return os.path.splitext(shader)[1][1:]
+
+def build_corpus(shader_dir, corpus_dir):
+    os.makedirs(corpus_dir, exist_ok = True)
+    built = 0
+    skipped = 0
+    stages = collections.Counter()
+    for root, dirs, files in os.walk(shader_dir):
+        dirs.sort()
+        for i in sorted(files):
+            path = os.path.join(root, i)
+            output = os.path.join(corpus_dir, i + '.spv')
+            try:
+                build_shader(path, output)
+                built += 1
+                stages[shader_stage(i)] += 1
+            except (OSError, subprocess.CalledProcessError) as e:
+                sys.stderr.write('Skipping {}: {}\n'.format(path, e))
+                skipped += 1
+    print('Built {} modules, skipped {}.'.format(built, skipped))
+    print('Modules per stage: {}'.format(', '.join('{} {}'.format(k, v) for k, v in sorted(stages.items()))))
+    return skipped == 0
+
+def main():
+    script_dir = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description = 'Script for rebuilding the benchmark corpus.')
+    parser.add_argument('--shaders',
+            default = os.path.join(script_dir, '..', 'shaders'),
+            help = 'Folder containing shader files to build.')
+    parser.add_argument('--output',
+            default = os.path.join(script_dir, 'corpus'),
+            help = 'Folder to write SPIR-V modules to.')
+    parser.add_argument('--allow-partial', action = 'store_true',
+            help = 'Skip shaders which cannot be built instead of failing.')
+    args = parser.parse_args()
+
+    if not args.allow_partial:
+        missing = [tool for tool in ('glslangValidator', 'spirv-as') if shutil.which(tool) is None]
+        if missing:
+            sys.stderr.write('Missing {} in PATH. Use --allow-partial to build a partial corpus.\n'.format(', '.join(missing)))
+            sys.exit(1)
+
+    if not build_corpus(args.shaders, args.output) and not args.allow_partial:
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
@@ -17,6 +17,7 @@
 #ifndef SPIRV_CROSS_BARRIER_HPP
 #define SPIRV_CROSS_BARRIER_HPP
 
+#include "fiber.hpp"
 #include <atomic>
 #include <thread>
 
@@ -49,6 +50,13 @@ public:
 
 	void wait()
 	{
+#ifdef SPIRV_CROSS_FIBERS
+		// Invocations running as fibers reach the barrier one after another on the same thread,
+		// so handing over to the next one is all there is to do.
+		if (FiberScheduler::yield())
+			return;
+#endif
+
 		unsigned target_iteration = iteration.load(std::memory_order_relaxed) + 1;
 		// Overflows cleanly.
 		unsigned target_count = divisor * target_iteration;
@@ -30,6 +30,10 @@ struct spirv_cross_interface
 	spirv_cross_shader_t *(*construct)(void);
 	void (*destruct)(spirv_cross_shader_t *thiz);
 	void (*invoke)(spirv_cross_shader_t *thiz);
+
+	// Runs x * y * z workgroups of a compute shader across all cores, setting the work group builtins itself.
+	// NULL for other shader stages.
+	void (*dispatch)(spirv_cross_shader_t *thiz, unsigned x, unsigned y, unsigned z);
 };
 
 void spirv_cross_set_stage_input(spirv_cross_shader_t *thiz, unsigned location, void *data, size_t size);
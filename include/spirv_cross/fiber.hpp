@@ -0,0 +1,180 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_FIBER_HPP
+#define SPIRV_CROSS_FIBER_HPP
+
+// Fibers are built on POSIX ucontext. Elsewhere, or with SPIRV_CROSS_NO_FIBERS,
+// compute shaders which use barrier() fall back to one thread per invocation.
+#if !defined(_WIN32) && !defined(SPIRV_CROSS_NO_FIBERS)
+#define SPIRV_CROSS_FIBERS 1
+#endif
+
+#ifdef SPIRV_CROSS_FIBERS
+
+// The ucontext functions are only declared for X/Open applications on Apple platforms.
+#if defined(__APPLE__) && !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 600
+#endif
+
+#include <new>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <vector>
+
+namespace spirv_cross
+{
+// Runs a fixed number of invocations as cooperative fibers on the calling thread.
+// Each invocation runs until it finishes or calls yield(), and the scheduler then moves on to the next one,
+// round-robin. If every invocation waits on the same barriers, as GLSL requires, running a full round
+// between two yields of the same invocation is exactly a workgroup barrier.
+// A switch is a swapcontext(), which also saves and restores the signal mask with a system call,
+// so it costs about as much as a syscall rather than a function call.
+class FiberScheduler
+{
+public:
+	// Invocations with large local arrays may need more.
+	static const size_t DefaultStackSize = 64 * 1024;
+
+	// Every fiber gets stack_size bytes of stack, rounded up to whole pages, below which lies
+	// an inaccessible guard page, so that overflowing the stack faults instead of corrupting memory.
+	explicit FiberScheduler(unsigned count, size_t stack_size = DefaultStackSize)
+	    : fibers(count)
+	{
+		for (auto &fiber : fibers)
+			fiber.stack.allocate(stack_size);
+	}
+
+	virtual ~FiberScheduler() = default;
+
+	// Runs every invocation to completion.
+	void run()
+	{
+		FiberScheduler *outer = current();
+		current() = this;
+
+		for (unsigned i = 0; i < unsigned(fibers.size()); i++)
+		{
+			auto &fiber = fibers[i];
+			fiber.done = false;
+			getcontext(&fiber.context);
+			fiber.context.uc_stack.ss_sp = fiber.stack.base;
+			fiber.context.uc_stack.ss_size = fiber.stack.size;
+			fiber.context.uc_link = &scheduler_context;
+			makecontext(&fiber.context, reinterpret_cast<void (*)()>(&entry), 1, int(i));
+		}
+
+		unsigned remaining = unsigned(fibers.size());
+		while (remaining)
+		{
+			for (unsigned i = 0; i < unsigned(fibers.size()); i++)
+			{
+				if (fibers[i].done)
+					continue;
+
+				active = i;
+				swapcontext(&scheduler_context, &fibers[i].context);
+				if (fibers[i].done)
+					remaining--;
+			}
+		}
+
+		current() = outer;
+	}
+
+	// Switches to the next invocation. Returns false if the caller is not running on a fiber.
+	static bool yield()
+	{
+		FiberScheduler *scheduler = current();
+		if (!scheduler)
+			return false;
+
+		swapcontext(&scheduler->fibers[scheduler->active].context, &scheduler->scheduler_context);
+		return true;
+	}
+
+protected:
+	virtual void invoke(unsigned index) = 0;
+
+private:
+	// Stacks grow down, so the guard page is the lowest page of the mapping.
+	struct Stack
+	{
+		Stack() = default;
+		Stack(const Stack &) = delete;
+		Stack &operator=(const Stack &) = delete;
+
+		~Stack()
+		{
+			if (mapping)
+				munmap(mapping, mapping_size);
+		}
+
+		void allocate(size_t stack_size)
+		{
+			size_t page = size_t(sysconf(_SC_PAGESIZE));
+			size = (stack_size + page - 1) & ~(page - 1);
+			mapping_size = size + page;
+
+			void *ptr = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+			if (ptr == MAP_FAILED)
+				throw std::bad_alloc();
+			mapping = static_cast<char *>(ptr);
+
+			if (mprotect(mapping, page, PROT_NONE) != 0)
+				throw std::bad_alloc();
+			base = mapping + page;
+		}
+
+		char *mapping = nullptr;
+		size_t mapping_size = 0;
+		char *base = nullptr;
+		size_t size = 0;
+	};
+
+	struct Fiber
+	{
+		ucontext_t context;
+		Stack stack;
+		bool done = false;
+	};
+
+	std::vector<Fiber> fibers;
+	ucontext_t scheduler_context;
+	unsigned active = 0;
+
+	// The scheduler running on this thread, if any.
+	static FiberScheduler *&current()
+	{
+		static thread_local FiberScheduler *scheduler = nullptr;
+		return scheduler;
+	}
+
+	// Fibers start on the thread of their scheduler, so the index is all they need to be passed.
+	static void entry(int index)
+	{
+		FiberScheduler *scheduler = current();
+		scheduler->invoke(unsigned(index));
+		scheduler->fibers[index].done = true;
+		// Returning resumes the scheduler through uc_link.
+	}
+};
+}
+
+#endif
+
+#endif
@@ -35,7 +35,11 @@
 #include "sampler.hpp"
 #include "thread_group.hpp"
 #include <assert.h>
+#include <memory>
+#include <mutex>
 #include <stdint.h>
+#include <type_traits>
+#include <vector>
 
 namespace internal
 {
@@ -321,6 +325,27 @@ struct spirv_cross_shader
 		*push_constant.ptr = data;
 	}
 
+	// Points every interface of this shader, which must be of the same type as other, at whatever other's point at.
+	void copy_bindings(const spirv_cross_shader &other)
+	{
+		const auto copy = [](PPSize *dst, const PPSize *src, unsigned count) {
+			for (unsigned i = 0; i < count; i++)
+				if (src[i].ptr)
+					*dst[i].ptr = *src[i].ptr;
+		};
+
+		for (unsigned set = 0; set < SPIRV_CROSS_NUM_DESCRIPTOR_SETS; set++)
+			for (unsigned binding = 0; binding < SPIRV_CROSS_NUM_DESCRIPTOR_BINDINGS; binding++)
+				if (other.resources[set][binding].ptr)
+					*resources[set][binding].ptr = *other.resources[set][binding].ptr;
+
+		copy(stage_inputs, other.stage_inputs, SPIRV_CROSS_NUM_STAGE_INPUTS);
+		copy(stage_outputs, other.stage_outputs, SPIRV_CROSS_NUM_STAGE_OUTPUTS);
+		copy(uniform_constants, other.uniform_constants, SPIRV_CROSS_NUM_UNIFORM_CONSTANTS);
+		copy(&push_constant, &other.push_constant, 1);
+		copy(builtins, other.builtins, SPIRV_CROSS_NUM_BUILTINS);
+	}
+
 	void set_resource(unsigned set, unsigned binding, void **data, size_t size)
 	{
 		assert(set < SPIRV_CROSS_NUM_DESCRIPTOR_SETS);
@@ -504,29 +529,59 @@ struct ComputePrivateResources
 #define gl_GlobalInvocationID __priv_res.gl_GlobalInvocationID__
 };
 
-template <typename T, typename Res, unsigned WorkGroupX, unsigned WorkGroupY, unsigned WorkGroupZ>
-struct ComputeShader : BaseShader<ComputeShader<T, Res, WorkGroupX, WorkGroupY, WorkGroupZ>>
+// Barriers is false if the shader never calls barrier(), which lets the invocations run on the shared thread pool.
+// Otherwise, the invocations run as fibers on the calling thread.
+template <typename T, typename Res, unsigned WorkGroupX, unsigned WorkGroupY, unsigned WorkGroupZ, bool Barriers = true>
+struct ComputeShader : BaseShader<ComputeShader<T, Res, WorkGroupX, WorkGroupY, WorkGroupZ, Barriers>>
 {
-	inline void main()
+	enum
 	{
-		resources.barrier__.reset_counter();
-
-		for (unsigned z = 0; z < WorkGroupZ; z++)
-			for (unsigned y = 0; y < WorkGroupY; y++)
-				for (unsigned x = 0; x < WorkGroupX; x++)
-					impl[z][y][x].__priv_res.gl_GlobalInvocationID__ =
-					    glm::uvec3(WorkGroupX, WorkGroupY, WorkGroupZ) * resources.gl_WorkGroupID__.get() +
-					    glm::uvec3(x, y, z);
+		Size = WorkGroupX * WorkGroupY * WorkGroupZ
+	};
 
+	// Runs the workgroup set with SPIRV_CROSS_BUILTIN_WORK_GROUP_ID.
+	inline void main()
+	{
+		begin_workgroup();
 		group.run();
 		group.wait();
 	}
 
+	// Runs x * y * z workgroups, spread over the shared thread pool one workgroup at a time.
+	// Every thread gets its own copy of the shader, so shared variables and invocation state are per workgroup.
+	// Work group IDs are generated, so only the other interfaces need to be set.
+	void dispatch(unsigned x, unsigned y, unsigned z)
+	{
+		glm::uvec3 num_workgroups(x, y, z);
+		ThreadPool::get_default().run(x * y * z, [&](unsigned index) {
+			std::unique_ptr<ComputeShader> instance = acquire_instance();
+
+			glm::uvec3 id(index % x, (index / x) % y, index / (x * y));
+			instance->resources.gl_WorkGroupID__.ptr = &id;
+			instance->resources.gl_NumWorkGroups__.ptr = &num_workgroups;
+
+			// The pool is already busy with other workgroups, so keep the invocations on this thread.
+			instance->begin_workgroup();
+			if (Barriers)
+			{
+				instance->group.run();
+				instance->group.wait();
+			}
+			else
+			{
+				for (unsigned i = 0; i < unsigned(Size); i++)
+					(&instance->impl[0][0][0])[i].main();
+			}
+
+			release_instance(std::move(instance));
+		});
+	}
+
 	ComputeShader()
 	    : group(&impl[0][0][0])
 	{
 		resources.init(*this);
-		resources.barrier__.set_release_divisor(WorkGroupX * WorkGroupY * WorkGroupZ);
+		resources.barrier__.set_release_divisor(Size);
 
 		unsigned i = 0;
 		for (unsigned z = 0; z < WorkGroupZ; z++)
@@ -544,8 +599,50 @@ struct ComputeShader : BaseShader<ComputeShader<T, Res, WorkGroupX, WorkGroupY,
 	}
 
 	T impl[WorkGroupZ][WorkGroupY][WorkGroupX];
-	ThreadGroup<T, WorkGroupX * WorkGroupY * WorkGroupZ> group;
+	typename std::conditional<Barriers, BarrierGroup<T, Size>, PooledGroup<T, Size>>::type group;
 	Res resources;
+
+private:
+	// Copies used by dispatch(), kept around for the next one.
+	std::vector<std::unique_ptr<ComputeShader>> instances;
+	std::mutex instances_lock;
+
+	void begin_workgroup()
+	{
+		resources.barrier__.reset_counter();
+
+		for (unsigned z = 0; z < WorkGroupZ; z++)
+			for (unsigned y = 0; y < WorkGroupY; y++)
+				for (unsigned x = 0; x < WorkGroupX; x++)
+					impl[z][y][x].__priv_res.gl_GlobalInvocationID__ =
+					    glm::uvec3(WorkGroupX, WorkGroupY, WorkGroupZ) * resources.gl_WorkGroupID__.get() +
+					    glm::uvec3(x, y, z);
+	}
+
+	// Interfaces may have been rebound since an instance was last used, so bindings are copied every time.
+	std::unique_ptr<ComputeShader> acquire_instance()
+	{
+		std::unique_ptr<ComputeShader> instance;
+		{
+			std::lock_guard<std::mutex> l{ instances_lock };
+			if (!instances.empty())
+			{
+				instance = std::move(instances.back());
+				instances.pop_back();
+			}
+		}
+
+		if (!instance)
+			instance.reset(new ComputeShader);
+		instance->copy_bindings(*this);
+		return instance;
+	}
+
+	void release_instance(std::unique_ptr<ComputeShader> instance)
+	{
+		std::lock_guard<std::mutex> l{ instances_lock };
+		instances.push_back(std::move(instance));
+	}
 };
 
 inline void memoryBarrierShared()
@@ -17,6 +17,8 @@
 #ifndef SPIRV_CROSS_THREAD_GROUP_HPP
 #define SPIRV_CROSS_THREAD_GROUP_HPP
 
+#include "fiber.hpp"
+#include "thread_pool.hpp"
 #include <condition_variable>
 #include <mutex>
 #include <thread>
@@ -108,6 +110,72 @@ private:
 	};
 	Thread workers[Size];
 };
+
+// Runs the invocations of a workgroup which never waits on a barrier.
+// Such invocations cannot observe each other's progress, so they are plain calls in a loop,
+// spread over the cores by the thread pool shared by all shader instances.
+template <typename T, unsigned Size>
+class PooledGroup
+{
+public:
+	PooledGroup(T *impl_)
+	    : impl(impl_)
+	{
+	}
+
+	void run()
+	{
+		T *invocations = impl;
+		ThreadPool::get_default().run(Size, [invocations](unsigned i) { invocations[i].main(); });
+	}
+
+	// run() only returns once every invocation is done.
+	void wait()
+	{
+	}
+
+private:
+	T *impl;
+};
+
+#ifdef SPIRV_CROSS_FIBERS
+// Runs the invocations of a workgroup which waits on barriers as fibers on the calling thread,
+// where a barrier is a switch to the next invocation.
+template <typename T, unsigned Size, size_t StackSize = FiberScheduler::DefaultStackSize>
+class FiberGroup : private FiberScheduler
+{
+public:
+	FiberGroup(T *impl_)
+	    : FiberScheduler(Size, StackSize)
+	    , impl(impl_)
+	{
+	}
+
+	void run()
+	{
+		FiberScheduler::run();
+	}
+
+	// run() only returns once every invocation is done.
+	void wait()
+	{
+	}
+
+private:
+	T *impl;
+
+	void invoke(unsigned index) override
+	{
+		impl[index].main();
+	}
+};
+
+template <typename T, unsigned Size>
+using BarrierGroup = FiberGroup<T, Size>;
+#else
+template <typename T, unsigned Size>
+using BarrierGroup = ThreadGroup<T, Size>;
+#endif
 }
 
 #endif
@@ -0,0 +1,238 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_THREAD_POOL_HPP
+#define SPIRV_CROSS_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace spirv_cross
+{
+// Fixed-size pool of worker threads which runs loops of independent tasks.
+// A loop is split into one contiguous range per thread, and threads which run out
+// steal half of the remaining range of another thread, so uneven tasks still balance out.
+// Threads claim tasks from their own range in chunks, so small tasks do not pay for a lock each.
+// The calling thread takes part in its own loops, so loops may be started from inside a task,
+// and several threads may run loops on the same pool at once.
+class ThreadPool
+{
+public:
+	// num_threads counts the calling thread, so a pool of one thread spawns no workers.
+	explicit ThreadPool(unsigned num_threads)
+	{
+		thread_count = std::max(num_threads, 1u);
+		for (unsigned i = 1; i < thread_count; i++)
+			workers.emplace_back([this] { work(); });
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> l{ lock };
+			dying = true;
+			cond.notify_all();
+		}
+
+		for (auto &worker : workers)
+			worker.join();
+	}
+
+	// The pool shared by all shader instances, with one thread per core.
+	static ThreadPool &get_default()
+	{
+		static ThreadPool pool(std::thread::hardware_concurrency());
+		return pool;
+	}
+
+	unsigned get_thread_count() const
+	{
+		return thread_count;
+	}
+
+	// Calls func(index) for every index in [0, count) and returns once all calls are done.
+	template <typename Func>
+	void run(unsigned count, const Func &func)
+	{
+		if (thread_count == 1 || count < 2)
+		{
+			for (unsigned i = 0; i < count; i++)
+				func(i);
+			return;
+		}
+
+		Loop loop(count, thread_count, &call<Func>, &func);
+		{
+			std::lock_guard<std::mutex> l{ lock };
+			loops.push_back(&loop);
+			cond.notify_all();
+		}
+
+		loop.work(0);
+
+		// Every task has been claimed, but workers may still be running theirs.
+		std::unique_lock<std::mutex> l{ lock };
+		auto itr = std::find(std::begin(loops), std::end(loops), &loop);
+		if (itr != std::end(loops))
+			loops.erase(itr);
+		done_cond.wait(l, [&loop] { return loop.busy == 0; });
+	}
+
+private:
+	// Tasks [begin, end) not yet claimed by any thread.
+	// Each range is allocated separately so that threads do not share cache lines.
+	struct Range
+	{
+		std::mutex lock;
+		unsigned begin = 0;
+		unsigned end = 0;
+	};
+
+	struct Loop
+	{
+		Loop(unsigned count, unsigned slot_count, void (*func_)(const void *, unsigned), const void *context_)
+		    : func(func_)
+		    , context(context_)
+		{
+			for (unsigned i = 0; i < slot_count; i++)
+			{
+				std::unique_ptr<Range> range(new Range);
+				range->begin = unsigned(uint64_t(count) * i / slot_count);
+				range->end = unsigned(uint64_t(count) * (i + 1) / slot_count);
+				ranges.push_back(std::move(range));
+			}
+		}
+
+		// Claims an eighth of the remaining range, at least one task. Chunks shrink along with the range,
+		// so most of it stays available to steal until the loop is nearly done.
+		bool pop(unsigned slot, unsigned &begin, unsigned &end)
+		{
+			auto &range = *ranges[slot];
+			std::lock_guard<std::mutex> l{ range.lock };
+			if (range.begin == range.end)
+				return false;
+			begin = range.begin;
+			range.begin += std::max((range.end - range.begin) / 8, 1u);
+			end = range.begin;
+			return true;
+		}
+
+		// Moves the upper half of some other thread's remaining tasks into our own range.
+		// No tasks are ever added, so failing to find any means the loop is drained
+		// apart from tasks already claimed by other threads.
+		bool steal(unsigned slot)
+		{
+			unsigned count = unsigned(ranges.size());
+			for (unsigned i = 1; i < count; i++)
+			{
+				auto &victim = *ranges[(slot + i) % count];
+				unsigned begin, end;
+				{
+					std::lock_guard<std::mutex> l{ victim.lock };
+					if (victim.begin == victim.end)
+						continue;
+
+					end = victim.end;
+					begin = victim.begin + (victim.end - victim.begin) / 2;
+					victim.end = begin;
+				}
+
+				auto &range = *ranges[slot];
+				std::lock_guard<std::mutex> l{ range.lock };
+				range.begin = begin;
+				range.end = end;
+				return true;
+			}
+
+			return false;
+		}
+
+		void work(unsigned slot)
+		{
+			for (;;)
+			{
+				unsigned begin, end;
+				if (pop(slot, begin, end))
+				{
+					for (unsigned i = begin; i < end; i++)
+						func(context, i);
+				}
+				else if (!steal(slot))
+					break;
+			}
+		}
+
+		void (*func)(const void *context, unsigned index);
+		const void *context;
+		std::vector<std::unique_ptr<Range>> ranges;
+
+		// Slot 0 belongs to the thread which started the loop. Guarded by the pool lock.
+		unsigned next_slot = 1;
+		unsigned busy = 0;
+	};
+
+	template <typename Func>
+	static void call(const void *context, unsigned index)
+	{
+		(*static_cast<const Func *>(context))(index);
+	}
+
+	void work()
+	{
+		for (;;)
+		{
+			Loop *loop;
+			unsigned slot;
+			{
+				std::unique_lock<std::mutex> l{ lock };
+				cond.wait(l, [this] { return dying || !loops.empty(); });
+				if (dying)
+					return;
+
+				// Join the oldest loop, and stop offering it once every slot is taken.
+				loop = loops.front();
+				slot = loop->next_slot++;
+				if (loop->next_slot == loop->ranges.size())
+					loops.pop_front();
+				loop->busy++;
+			}
+
+			loop->work(slot);
+
+			std::lock_guard<std::mutex> l{ lock };
+			if (--loop->busy == 0)
+				done_cond.notify_all();
+		}
+	}
+
+	unsigned thread_count;
+	std::vector<std::thread> workers;
+
+	std::mutex lock;
+	std::condition_variable cond;
+	std::condition_variable done_cond;
+	std::deque<Loop *> loops;
+	bool dying = false;
+};
+}
+
+#endif
@@ -388,6 +388,27 @@ static void print_spec_constants(const Compiler &compiler)
 	fprintf(stderr, "==================\n\n");
 }
 
+static void print_stats(const CompilerStats &stats)
+{
+	fprintf(stderr, "Compiler stats\n");
+	fprintf(stderr, "==================\n\n");
+	fprintf(stderr, "Parse: %.1f us\n", stats.parse_us);
+	fprintf(stderr, "Combined image samplers: %.1f us\n", stats.combined_image_samplers_us);
+	fprintf(stderr, "Variable scope analysis: %.1f us (CFG: %.1f us)\n", stats.variable_scope_us, stats.cfg_us);
+	for (size_t i = 0; i < stats.passes.size(); i++)
+	{
+		auto &pass = stats.passes[i];
+		fprintf(stderr, "Pass %u: %.1f us, %llu bytes%s\n", unsigned(i), pass.emit_us,
+		        static_cast<unsigned long long>(pass.emitted_bytes), pass.forced_recompile ? ", forced recompile" : "");
+	}
+	for (auto &func : stats.functions)
+		fprintf(stderr, "Function %u: %.1f us\n", func.id, func.emit_us);
+	fprintf(stderr, "Forced temporaries: %u\n", stats.forced_temporaries);
+	fprintf(stderr, "Invalidated expressions: %u\n", stats.invalidated_expressions);
+	fprintf(stderr, "Emitted bytes: %llu\n", static_cast<unsigned long long>(stats.emitted_bytes));
+	fprintf(stderr, "==================\n\n");
+}
+
 struct PLSArg
 {
 	PlsFormat format;
@@ -417,6 +438,7 @@ struct CLIArguments
 	bool set_version = false;
 	bool set_es = false;
 	bool dump_resources = false;
+	bool dump_stats = false;
 	bool force_temporary = false;
 	bool flatten_ubo = false;
 	bool fixup = false;
@@ -433,13 +455,15 @@ struct CLIArguments
 	bool vulkan_semantics = false;
 	bool remove_unused = false;
 	bool cfg_analysis = true;
+	uint32_t cfg_analysis_threads = 1;
+	uint32_t max_forwarded_expression_size = 0;
 };
 
 static void print_help()
 {
 	fprintf(stderr, "Usage: spirv-cross [--output <output path>] [SPIR-V file] [--es] [--no-es] [--no-cfg-analysis] "
-	                "[--version <GLSL "
-	                "version>] [--dump-resources] [--help] [--force-temporary] [--cpp] [--cpp-interface-name <name>] "
+	                "[--cfg-analysis-threads <count>] [--max-forwarded-expression-size <characters>] [--version <GLSL "
+	                "version>] [--dump-resources] [--dump-stats] [--help] [--force-temporary] [--cpp] [--cpp-interface-name <name>] "
 	                "[--metal] [--vulkan-semantics] [--flatten-ubo] [--fixup-clipspace] [--iterations iter] [--pls-in "
 	                "format input-name] [--pls-out format output-name] [--remap source_name target_name components] "
 	                "[--extension ext] [--entry name] [--remove-unused-variables] "
@@ -553,7 +577,11 @@ int main(int argc, char *argv[])
 		args.set_version = true;
 	});
 	cbs.add("--no-cfg-analysis", [&args](CLIParser &) { args.cfg_analysis = false; });
+	cbs.add("--cfg-analysis-threads", [&args](CLIParser &parser) { args.cfg_analysis_threads = parser.next_uint(); });
+	cbs.add("--max-forwarded-expression-size",
+	        [&args](CLIParser &parser) { args.max_forwarded_expression_size = parser.next_uint(); });
 	cbs.add("--dump-resources", [&args](CLIParser &) { args.dump_resources = true; });
+	cbs.add("--dump-stats", [&args](CLIParser &) { args.dump_stats = true; });
 	cbs.add("--force-temporary", [&args](CLIParser &) { args.force_temporary = true; });
 	cbs.add("--flatten-ubo", [&args](CLIParser &) { args.flatten_ubo = true; });
 	cbs.add("--fixup-clipspace", [&args](CLIParser &) { args.fixup = true; });
@@ -616,18 +644,23 @@ int main(int argc, char *argv[])
 
 	if (args.cpp)
 	{
-		compiler = unique_ptr<CompilerGLSL>(new CompilerCPP(read_spirv_file(args.input)));
+		compiler = unique_ptr<CompilerGLSL>(new CompilerCPP(read_spirv_file(args.input), args.dump_stats));
 		if (args.cpp_interface_name)
 			static_cast<CompilerCPP *>(compiler.get())->set_interface_name(args.cpp_interface_name);
 	}
 	else if (args.metal)
-		compiler = unique_ptr<CompilerMSL>(new CompilerMSL(read_spirv_file(args.input)));
+	{
+		compiler = unique_ptr<CompilerMSL>(new CompilerMSL(read_spirv_file(args.input), args.dump_stats));
+		static_cast<CompilerMSL *>(compiler.get())->set_repeatable_compile(args.iterations > 1);
+	}
 	else
 	{
 		combined_image_samplers = !args.vulkan_semantics;
-		compiler = unique_ptr<CompilerGLSL>(new CompilerGLSL(read_spirv_file(args.input)));
+		compiler = unique_ptr<CompilerGLSL>(new CompilerGLSL(read_spirv_file(args.input), args.dump_stats));
 	}
 
+	compiler->set_stats_enabled(args.dump_stats);
+
 	if (!args.variable_type_remaps.empty())
 	{
 		auto remap_cb = [&](const SPIRType &, const string &name, string &out) -> void {
@@ -658,6 +691,8 @@ int main(int argc, char *argv[])
 	opts.vulkan_semantics = args.vulkan_semantics;
 	opts.vertex.fixup_clipspace = args.fixup;
 	opts.cfg_analysis = args.cfg_analysis;
+	opts.cfg_analysis_threads = args.cfg_analysis_threads;
+	opts.max_forwarded_expression_size = args.max_forwarded_expression_size;
 	compiler->set_options(opts);
 
 	ShaderResources res;
@@ -713,6 +748,9 @@ int main(int argc, char *argv[])
 	for (uint32_t i = 0; i < args.iterations; i++)
 		glsl = compiler->compile();
 
+	if (args.dump_stats)
+		print_stats(compiler->get_stats());
+
 	if (args.output)
 		write_string_to_file(args.output, glsl.c_str());
 	else
@@ -43,13 +43,13 @@ void main()
     scatter_uv.x = saturate(param);
     vec3 nEye = normalize(EyeVec);
     scatter_uv.y = 0.0;
-    vec3 Color = vec3(0.100000001490116119384765625, 0.300000011920928955078125, 0.100000001490116119384765625);
-    vec3 grass = vec3(0.100000001490116119384765625, 0.300000011920928955078125, 0.100000001490116119384765625);
-    vec3 dirt = vec3(0.100000001490116119384765625);
-    vec3 snow = vec3(0.800000011920928955078125);
-    float grass_snow = smoothstep(0.0, 0.1500000059604644775390625, (_56.g_CamPos.y + EyeVec.y) / 200.0);
+    vec3 Color = vec3(0.1, 0.3, 0.1);
+    vec3 grass = vec3(0.1, 0.3, 0.1);
+    vec3 dirt = vec3(0.1);
+    vec3 snow = vec3(0.8);
+    float grass_snow = smoothstep(0.0, 0.15, (_56.g_CamPos.y + EyeVec.y) / 200.0);
     vec3 base = mix(grass, snow, vec3(grass_snow));
-    float edge = smoothstep(0.699999988079071044921875, 0.75, Normal.y);
+    float edge = smoothstep(0.7, 0.75, Normal.y);
     Color = mix(dirt, base, vec3(edge));
     Color *= Color;
     float Roughness = 1.0 - (edge * grass_snow);
@@ -58,21 +58,11 @@ int main()
 	spirv_cross_set_resource(shader, 0, 0, &aptr, sizeof(aptr));
 	spirv_cross_set_resource(shader, 0, 1, &bptr, sizeof(bptr));
 
-	// We also have to set builtins.
-	// The relevant builtins will depend on the shader,
-	// but for compute, there are few builtins, which are gl_NumWorkGroups and gl_WorkGroupID.
+	// Execute 4 work groups, spread over all cores.
+	// Dispatching sets the compute builtins, gl_NumWorkGroups and gl_WorkGroupID, for every work group.
 	// LocalInvocationID and GlobalInvocationID are inferred when executing the invocation.
-	uvec3 num_workgroups(NUM_WORKGROUPS, 1, 1);
-	uvec3 work_group_id(0, 0, 0);
-	spirv_cross_set_builtin(shader, SPIRV_CROSS_BUILTIN_NUM_WORK_GROUPS, &num_workgroups, sizeof(num_workgroups));
-	spirv_cross_set_builtin(shader, SPIRV_CROSS_BUILTIN_WORK_GROUP_ID, &work_group_id, sizeof(work_group_id));
-
-	// Execute 4 work groups.
-	for (unsigned i = 0; i < NUM_WORKGROUPS; i++)
-	{
-		work_group_id.x = i;
-		iface->invoke(shader);
-	}
+	// To run a single work group with invoke() instead, set those builtins with spirv_cross_set_builtin().
+	iface->dispatch(shader, NUM_WORKGROUPS, 1, 1);
 
 	// Call destructor.
 	iface->destruct(shader);
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spirv_batch.hpp"
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace spv;
+using namespace spirv_cross;
+using namespace std;
+
+namespace
+{
+// Jobs [begin, end) not yet picked up by any worker.
+// Each range is allocated separately so that workers do not share cache lines.
+struct WorkRange
+{
+	mutex lock;
+	size_t begin = 0;
+	size_t end = 0;
+};
+
+struct Scheduler
+{
+	Scheduler(const vector<BatchJob> &jobs_, vector<BatchResult> &results_, CompileCache *cache_,
+	          unsigned worker_count)
+	    : jobs(jobs_)
+	    , results(results_)
+	    , cache(cache_)
+	{
+		size_t count = jobs.size();
+		for (unsigned i = 0; i < worker_count; i++)
+		{
+			unique_ptr<WorkRange> range(new WorkRange);
+			range->begin = count * i / worker_count;
+			range->end = count * (i + 1) / worker_count;
+			ranges.push_back(move(range));
+		}
+	}
+
+	bool pop(unsigned worker, size_t &index)
+	{
+		auto &range = *ranges[worker];
+		lock_guard<mutex> holder{ range.lock };
+		if (range.begin == range.end)
+			return false;
+		index = range.begin++;
+		return true;
+	}
+
+	// Moves the upper half of some other worker's remaining jobs into our own range.
+	// No jobs are ever added, so failing to find any means the batch is drained
+	// apart from jobs already claimed by other workers.
+	bool steal(unsigned worker)
+	{
+		unsigned count = unsigned(ranges.size());
+		for (unsigned i = 1; i < count; i++)
+		{
+			auto &victim = *ranges[(worker + i) % count];
+			size_t begin, end;
+			{
+				lock_guard<mutex> holder{ victim.lock };
+				if (victim.begin == victim.end)
+					continue;
+
+				end = victim.end;
+				begin = victim.begin + (victim.end - victim.begin) / 2;
+				victim.end = begin;
+			}
+
+			auto &range = *ranges[worker];
+			lock_guard<mutex> holder{ range.lock };
+			range.begin = begin;
+			range.end = end;
+			return true;
+		}
+
+		return false;
+	}
+
+	void run(unsigned worker)
+	{
+		for (;;)
+		{
+			size_t index;
+			if (pop(worker, index))
+				results[index] = BatchCompiler::compile_job(jobs[index], cache);
+			else if (!steal(worker))
+				break;
+		}
+	}
+
+	const vector<BatchJob> &jobs;
+	vector<BatchResult> &results;
+	CompileCache *cache;
+	vector<unique_ptr<WorkRange>> ranges;
+};
+}
+
+BatchCompiler::BatchCompiler(unsigned num_threads)
+    : thread_count(num_threads)
+{
+	if (thread_count == 0)
+		thread_count = thread::hardware_concurrency();
+	if (thread_count == 0)
+		thread_count = 1;
+}
+
+bool BatchCompiler::get_job_hash(const BatchJob &job, HashValue &hash)
+{
+	if (job.setup && job.setup_key.empty())
+		return false;
+
+	Hasher hasher;
+	hasher.u32(kCompileHashVersion);
+	hasher.string("batch");
+	hasher.data(job.spirv, job.word_count);
+	hasher.u32(job.target);
+	hasher.string(job.entry_point);
+	// Only hash the GLSL options when they are applied. Otherwise they follow from the module.
+	bool glsl_options = job.set_glsl_options && job.target != BatchJob::MSL;
+	hasher.u32(glsl_options);
+	if (glsl_options)
+		CompilerGLSL::hash_options(hasher, job.glsl);
+	if (job.target == BatchJob::MSL)
+		CompileCache::hash_msl_inputs(hasher, job.msl, &job.msl_vertex_attrs, &job.msl_resource_bindings);
+	hasher.string(job.setup_key);
+
+	hash = hasher.get();
+	return true;
+}
+
+BatchResult BatchCompiler::compile_job(const BatchJob &job, CompileCache *cache)
+{
+	BatchResult result;
+
+	// On a hit, the module is not even parsed.
+	HashValue hash = {};
+	bool cacheable = cache && get_job_hash(job, hash);
+	if (cacheable)
+	{
+		result.msl_vertex_attrs = job.msl_vertex_attrs;
+		result.msl_resource_bindings = job.msl_resource_bindings;
+		if (cache->load(hash, result.source, &result.msl_vertex_attrs, &result.msl_resource_bindings))
+		{
+			result.success = true;
+			result.cache_hit = true;
+			return result;
+		}
+	}
+
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+	try
+#endif
+	{
+		unique_ptr<CompilerGLSL> compiler;
+		switch (job.target)
+		{
+		case BatchJob::GLSL:
+			compiler.reset(new CompilerGLSL(job.spirv, job.word_count));
+			break;
+
+		case BatchJob::MSL:
+			compiler.reset(new CompilerMSL(job.spirv, job.word_count));
+			break;
+
+		case BatchJob::CPP:
+			compiler.reset(new CompilerCPP(job.spirv, job.word_count));
+			break;
+		}
+
+		if (!job.entry_point.empty())
+			compiler->set_entry_point(job.entry_point);
+
+		// The MSL target has its own configuration. GLSL options such as clip space fixup would break it.
+		if (job.set_glsl_options && job.target != BatchJob::MSL)
+		{
+			auto opts = job.glsl;
+			if (opts.version == 0)
+			{
+				opts.version = compiler->get_options().version;
+				opts.es = compiler->get_options().es;
+			}
+			compiler->set_options(opts);
+		}
+
+		if (job.setup)
+			job.setup(*compiler);
+
+		if (job.target == BatchJob::MSL)
+		{
+			auto msl_cfg = job.msl;
+			result.msl_vertex_attrs = job.msl_vertex_attrs;
+			result.msl_resource_bindings = job.msl_resource_bindings;
+			result.source = static_cast<CompilerMSL &>(*compiler).compile(
+			    msl_cfg, result.msl_vertex_attrs.empty() ? nullptr : &result.msl_vertex_attrs,
+			    result.msl_resource_bindings.empty() ? nullptr : &result.msl_resource_bindings);
+		}
+		else
+			result.source = compiler->compile();
+
+		result.success = true;
+
+		if (cacheable)
+			cache->store(hash, result.source, &result.msl_vertex_attrs, &result.msl_resource_bindings);
+	}
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+	catch (const exception &e)
+	{
+		result.source.clear();
+		result.error = e.what();
+	}
+#endif
+
+	return result;
+}
+
+vector<BatchResult> BatchCompiler::compile(const vector<BatchJob> &jobs) const
+{
+	vector<BatchResult> results(jobs.size());
+
+	unsigned worker_count = thread_count;
+	if (worker_count > jobs.size())
+		worker_count = unsigned(jobs.size());
+	if (worker_count == 0)
+		return results;
+
+	Scheduler scheduler(jobs, results, cache, worker_count);
+
+	// The calling thread acts as worker 0.
+	vector<thread> workers;
+	for (unsigned i = 1; i < worker_count; i++)
+		workers.emplace_back([&scheduler, i] { scheduler.run(i); });
+
+	scheduler.run(0);
+
+	for (auto &worker : workers)
+		worker.join();
+
+	return results;
+}
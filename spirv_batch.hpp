@@ -0,0 +1,121 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_BATCH_HPP
+#define SPIRV_CROSS_BATCH_HPP
+
+#include "spirv_cache.hpp"
+#include "spirv_cpp.hpp"
+#include "spirv_msl.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace spirv_cross
+{
+// One module to cross-compile as part of a batch.
+struct BatchJob
+{
+	enum Target
+	{
+		GLSL,
+		MSL,
+		CPP
+	};
+
+	// The SPIR-V is parsed in place, so this memory must stay valid
+	// until BatchCompiler::compile() returns.
+	const uint32_t *spirv = nullptr;
+	size_t word_count = 0;
+
+	Target target = GLSL;
+
+	// If not empty, selects the entry point to compile.
+	std::string entry_point;
+
+	// Used by the GLSL and C++ targets, and only if set_glsl_options is true. Otherwise the compiler
+	// keeps the options it derives from the module. A version of 0 keeps the version and ES profile
+	// declared by the module while still applying the other options.
+	bool set_glsl_options = false;
+	CompilerGLSL::Options glsl;
+
+	// Used by the MSL target. Vertex attributes and resource bindings are optional and are
+	// copied into the result with used_by_shader filled in.
+	MSLConfiguration msl;
+	std::vector<MSLVertexAttr> msl_vertex_attrs;
+	std::vector<MSLResourceBinding> msl_resource_bindings;
+
+	// Optional hook to apply remapping or other reflection changes before compiling.
+	// It is called on a worker thread, so it must not touch shared state without synchronization.
+	std::function<void(CompilerGLSL &compiler)> setup;
+
+	// Identifies what setup does, e.g. a hash of the remapping tables it applies.
+	// With a cache, jobs which have a setup hook but no setup_key are always compiled.
+	std::string setup_key;
+};
+
+struct BatchResult
+{
+	bool success = false;
+	std::string source;
+
+	// The compiler error if success is false.
+	std::string error;
+
+	std::vector<MSLVertexAttr> msl_vertex_attrs;
+	std::vector<MSLResourceBinding> msl_resource_bindings;
+
+	// True if the result came from the cache without parsing the module.
+	bool cache_hit = false;
+};
+
+// Cross-compiles many independent modules on a pool of threads.
+// Each worker owns a contiguous range of jobs and idle workers steal half of the
+// remaining range from another worker, so uneven module sizes still balance out.
+// Results are returned in the same order as the jobs.
+class BatchCompiler
+{
+public:
+	// A thread count of 0 uses std::thread::hardware_concurrency().
+	explicit BatchCompiler(unsigned num_threads = 0);
+
+	// Looks up jobs in cache before parsing them, and stores what had to be compiled.
+	// The cache must outlive any calls to compile(). Pass nullptr to disable caching.
+	void set_cache(CompileCache *cache_)
+	{
+		cache = cache_;
+	}
+
+	std::vector<BatchResult> compile(const std::vector<BatchJob> &jobs) const;
+
+	// Compiles a single job on the calling thread.
+	static BatchResult compile_job(const BatchJob &job, CompileCache *cache = nullptr);
+
+	// Computes the cache key of a job from its inputs alone. Returns false if the job cannot be cached.
+	static bool get_job_hash(const BatchJob &job, HashValue &hash);
+
+	unsigned get_thread_count() const
+	{
+		return thread_count;
+	}
+
+private:
+	unsigned thread_count;
+	CompileCache *cache = nullptr;
+};
+}
+
+#endif
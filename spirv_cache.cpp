@@ -0,0 +1,252 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spirv_cache.hpp"
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+using namespace spv;
+using namespace spirv_cross;
+using namespace std;
+
+DirectoryCacheStorage::DirectoryCacheStorage(string directory_)
+    : directory(move(directory_))
+    , temp_counter(0)
+{
+	if (!directory.empty() && directory.back() != '/' && directory.back() != '\\')
+		directory += '/';
+}
+
+bool DirectoryCacheStorage::load(const string &key, string &value)
+{
+	FILE *file = fopen((directory + key).c_str(), "rb");
+	if (!file)
+		return false;
+
+	bool ok = fseek(file, 0, SEEK_END) == 0;
+	long len = ok ? ftell(file) : -1;
+	ok = len >= 0 && fseek(file, 0, SEEK_SET) == 0;
+	if (ok)
+	{
+		value.resize(size_t(len));
+		ok = len == 0 || fread(&value[0], 1, size_t(len), file) == size_t(len);
+	}
+
+	fclose(file);
+	return ok;
+}
+
+void DirectoryCacheStorage::store(const string &key, const string &value)
+{
+	// The temporary name must be unique across threads and processes sharing the directory.
+	auto unique = hash<thread::id>()(this_thread::get_id()) ^
+	              size_t(chrono::steady_clock::now().time_since_epoch().count());
+	string path = directory + key;
+	string temp_path = join(path, ".tmp.", uint64_t(unique), ".", temp_counter++);
+
+	FILE *file = fopen(temp_path.c_str(), "wb");
+	if (!file)
+		return;
+
+	bool ok = fwrite(value.data(), 1, value.size(), file) == value.size();
+	ok = fclose(file) == 0 && ok;
+
+	// A failure to cache is not an error, the entry will simply be compiled again next time.
+	if (!ok || rename(temp_path.c_str(), path.c_str()) != 0)
+		remove(temp_path.c_str());
+}
+
+CompileCache::CompileCache(CacheStorage &storage_)
+    : storage(storage_)
+    , hits(0)
+    , misses(0)
+{
+}
+
+static string cache_key(const HashValue &hash)
+{
+	static const char digits[] = "0123456789abcdef";
+	string key(32, '0');
+	uint64_t high = hash.high;
+	uint64_t low = hash.low;
+	for (int i = 15; i >= 0; i--, high >>= 4, low >>= 4)
+	{
+		key[i] = digits[high & 0xf];
+		key[i + 16] = digits[low & 0xf];
+	}
+	return key;
+}
+
+// Entries are laid out as:
+// "SPVC", format version (little-endian uint32), key (low and high little-endian uint64),
+// vertex attribute count, resource binding count (little-endian uint32),
+// one used_by_shader byte per attribute and binding, then the source.
+// Bump the format version whenever this layout changes.
+static const uint32_t entry_format_version = 1;
+static const size_t entry_header_size = 32;
+
+static void put_u32(string &str, uint32_t value)
+{
+	for (uint32_t i = 0; i < 4; i++)
+		str += char((value >> (8 * i)) & 0xff);
+}
+
+static uint32_t get_u32(const string &str, size_t offset)
+{
+	uint32_t value = 0;
+	for (uint32_t i = 0; i < 4; i++)
+		value |= uint32_t(uint8_t(str[offset + i])) << (8 * i);
+	return value;
+}
+
+static void put_u64(string &str, uint64_t value)
+{
+	put_u32(str, uint32_t(value));
+	put_u32(str, uint32_t(value >> 32));
+}
+
+static uint64_t get_u64(const string &str, size_t offset)
+{
+	return get_u32(str, offset) | (uint64_t(get_u32(str, offset + 4)) << 32);
+}
+
+bool CompileCache::load(const HashValue &hash, string &source, vector<MSLVertexAttr> *p_vtx_attrs,
+                        vector<MSLResourceBinding> *p_res_bindings)
+{
+	string entry;
+	if (!storage.load(cache_key(hash), entry) || entry.size() < entry_header_size || entry.compare(0, 4, "SPVC") != 0 ||
+	    get_u32(entry, 4) != entry_format_version || get_u64(entry, 8) != hash.low || get_u64(entry, 16) != hash.high)
+	{
+		misses++;
+		return false;
+	}
+
+	size_t num_attrs = p_vtx_attrs ? p_vtx_attrs->size() : 0;
+	size_t num_bindings = p_res_bindings ? p_res_bindings->size() : 0;
+	size_t offset = entry_header_size + num_attrs + num_bindings;
+
+	// Only a damaged entry can get here.
+	if (get_u32(entry, 24) != num_attrs || get_u32(entry, 28) != num_bindings || entry.size() < offset)
+	{
+		misses++;
+		return false;
+	}
+
+	size_t flag = entry_header_size;
+	for (size_t i = 0; i < num_attrs; i++)
+		(*p_vtx_attrs)[i].used_by_shader = entry[flag++] != 0;
+	for (size_t i = 0; i < num_bindings; i++)
+		(*p_res_bindings)[i].used_by_shader = entry[flag++] != 0;
+
+	source = entry.substr(offset);
+	hits++;
+	return true;
+}
+
+void CompileCache::store(const HashValue &hash, const string &source, const vector<MSLVertexAttr> *p_vtx_attrs,
+                         const vector<MSLResourceBinding> *p_res_bindings)
+{
+	size_t num_attrs = p_vtx_attrs ? p_vtx_attrs->size() : 0;
+	size_t num_bindings = p_res_bindings ? p_res_bindings->size() : 0;
+
+	string entry;
+	entry.reserve(entry_header_size + num_attrs + num_bindings + source.size());
+	entry += "SPVC";
+	put_u32(entry, entry_format_version);
+	put_u64(entry, hash.low);
+	put_u64(entry, hash.high);
+	put_u32(entry, uint32_t(num_attrs));
+	put_u32(entry, uint32_t(num_bindings));
+	for (size_t i = 0; i < num_attrs; i++)
+		entry += char((*p_vtx_attrs)[i].used_by_shader);
+	for (size_t i = 0; i < num_bindings; i++)
+		entry += char((*p_res_bindings)[i].used_by_shader);
+	entry += source;
+
+	storage.store(cache_key(hash), entry);
+}
+
+void CompileCache::hash_msl_inputs(Hasher &hasher, const MSLConfiguration &msl_cfg,
+                                   const vector<MSLVertexAttr> *p_vtx_attrs,
+                                   const vector<MSLResourceBinding> *p_res_bindings)
+{
+	hasher.u32(msl_cfg.vtx_attr_stage_in_binding);
+	hasher.u32(msl_cfg.flip_vert_y);
+	hasher.u32(msl_cfg.flip_frag_y);
+	hasher.u32(msl_cfg.is_rendering_points);
+
+	// A null list and an empty list mean different things to CompilerMSL::compile().
+	hasher.u32(p_vtx_attrs != nullptr);
+	if (p_vtx_attrs)
+	{
+		hasher.u32(uint32_t(p_vtx_attrs->size()));
+		for (auto &attr : *p_vtx_attrs)
+			hasher.u32(attr.location);
+	}
+
+	hasher.u32(p_res_bindings != nullptr);
+	if (p_res_bindings)
+	{
+		hasher.u32(uint32_t(p_res_bindings->size()));
+		for (auto &binding : *p_res_bindings)
+		{
+			hasher.u32(binding.stage);
+			hasher.u32(binding.desc_set);
+			hasher.u32(binding.binding);
+			hasher.u32(binding.msl_buffer);
+			hasher.u32(binding.msl_texture);
+			hasher.u32(binding.msl_sampler);
+		}
+	}
+}
+
+string CompileCache::compile(CompilerGLSL &compiler)
+{
+	HashValue hash;
+	if (!compiler.get_compile_hash(hash))
+		return compiler.compile();
+
+	string source;
+	if (load(hash, source))
+		return source;
+
+	source = compiler.compile();
+	store(hash, source);
+	return source;
+}
+
+string CompileCache::compile(CompilerMSL &compiler, MSLConfiguration &msl_cfg, vector<MSLVertexAttr> *p_vtx_attrs,
+                             vector<MSLResourceBinding> *p_res_bindings)
+{
+	HashValue hash;
+	if (!compiler.get_compile_hash(hash))
+		return compiler.compile(msl_cfg, p_vtx_attrs, p_res_bindings);
+
+	Hasher hasher;
+	hasher.value(hash);
+	hash_msl_inputs(hasher, msl_cfg, p_vtx_attrs, p_res_bindings);
+	hash = hasher.get();
+
+	string source;
+	if (load(hash, source, p_vtx_attrs, p_res_bindings))
+		return source;
+
+	source = compiler.compile(msl_cfg, p_vtx_attrs, p_res_bindings);
+	store(hash, source, p_vtx_attrs, p_res_bindings);
+	return source;
+}
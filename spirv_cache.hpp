@@ -0,0 +1,102 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPIRV_CROSS_CACHE_HPP
+#define SPIRV_CROSS_CACHE_HPP
+
+#include "spirv_msl.hpp"
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace spirv_cross
+{
+// Backing store for cached compilation results.
+// Implementations must be thread-safe if the cache is shared between threads, e.g. by BatchCompiler.
+class CacheStorage
+{
+public:
+	virtual ~CacheStorage() = default;
+
+	// Returns false if there is no entry for key.
+	virtual bool load(const std::string &key, std::string &value) = 0;
+	virtual void store(const std::string &key, const std::string &value) = 0;
+};
+
+// Stores each entry as a file named after its key in an existing directory.
+// Entries are written to a temporary file and renamed into place, so several threads
+// or processes can share a directory without ever reading a partially written entry.
+class DirectoryCacheStorage : public CacheStorage
+{
+public:
+	explicit DirectoryCacheStorage(std::string directory);
+
+	bool load(const std::string &key, std::string &value) override;
+	void store(const std::string &key, const std::string &value) override;
+
+private:
+	std::string directory;
+	std::atomic<uint32_t> temp_counter;
+};
+
+// Content-addressed cache around compile().
+// The key is Compiler::get_compile_hash(), so any reflection change or option which affects the
+// output also changes the key. Entries also record the full key and a format version, which are
+// checked on load, so a damaged or foreign entry is treated as a miss. On a hit, compile() is not called at all, which also means that
+// state compile() would normally update on the compiler, like resolved names, is left untouched.
+class CompileCache
+{
+public:
+	explicit CompileCache(CacheStorage &storage);
+
+	// Works for any backend deriving from CompilerGLSL which is compiled with compile().
+	std::string compile(CompilerGLSL &compiler);
+
+	// MSL takes its configuration as arguments, so they are part of the key as well.
+	// The used_by_shader flags of vertex attributes and resource bindings are restored on a hit.
+	std::string compile(CompilerMSL &compiler, MSLConfiguration &msl_cfg,
+	                    std::vector<MSLVertexAttr> *p_vtx_attrs = nullptr,
+	                    std::vector<MSLResourceBinding> *p_res_bindings = nullptr);
+
+	// Lower level access for callers which can compute a key without parsing, like BatchCompiler.
+	// On a successful load, the used_by_shader flags in p_vtx_attrs and p_res_bindings are updated.
+	bool load(const HashValue &hash, std::string &source, std::vector<MSLVertexAttr> *p_vtx_attrs = nullptr,
+	          std::vector<MSLResourceBinding> *p_res_bindings = nullptr);
+	void store(const HashValue &hash, const std::string &source, const std::vector<MSLVertexAttr> *p_vtx_attrs = nullptr,
+	           const std::vector<MSLResourceBinding> *p_res_bindings = nullptr);
+
+	static void hash_msl_inputs(Hasher &hasher, const MSLConfiguration &msl_cfg,
+	                            const std::vector<MSLVertexAttr> *p_vtx_attrs,
+	                            const std::vector<MSLResourceBinding> *p_res_bindings);
+
+	uint64_t get_hit_count() const
+	{
+		return hits;
+	}
+
+	uint64_t get_miss_count() const
+	{
+		return misses;
+	}
+
+private:
+	CacheStorage &storage;
+	std::atomic<uint64_t> hits;
+	std::atomic<uint64_t> misses;
+};
+}
+
+#endif
@@ -26,133 +26,366 @@ CFG::CFG(Compiler &compiler_, const SPIRFunction &func_)
     : compiler(compiler_)
     , func(func_)
 {
-	preceding_edges.resize(compiler.get_current_id_bound());
-	succeeding_edges.resize(compiler.get_current_id_bound());
-	visit_order.resize(compiler.get_current_id_bound());
-	immediate_dominators.resize(compiler.get_current_id_bound());
+	blocks = func.blocks;
+	block_indices.reserve(blocks.size());
+	for (uint32_t i = 0; i < uint32_t(blocks.size()); i++)
+		block_indices[blocks[i]] = i;
 
-	build_post_order_visit_order();
+	vector<pair<uint32_t, uint32_t>> back_edges;
+	build_post_order_visit_order(back_edges);
 	build_immediate_dominators();
+	build_dominance_frontiers(back_edges);
 }
 
 uint32_t CFG::find_common_dominator(uint32_t a, uint32_t b) const
 {
-	while (a != b)
-	{
-		if (visit_order[a] < visit_order[b])
-			a = immediate_dominators[a];
-		else
-			b = immediate_dominators[b];
-	}
-	return a;
-}
+	uint32_t first = euler_first_visit[get_block_index(a)];
+	uint32_t last = euler_first_visit[get_block_index(b)];
+	assert(first != Invalid && last != Invalid);
+	if (first > last)
+		swap(first, last);
 
-uint32_t CFG::update_common_dominator(uint32_t a, uint32_t b)
-{
-	auto dominator = find_common_dominator(immediate_dominators[a], immediate_dominators[b]);
-	immediate_dominators[a] = dominator;
-	immediate_dominators[b] = dominator;
-	return dominator;
+	// Two overlapping power-of-two ranges cover [first, last].
+	uint32_t level = 0;
+	while ((2u << level) <= last - first + 1)
+		level++;
+
+	uint32_t x = euler_min_table[level * euler_tour_size + first];
+	uint32_t y = euler_min_table[level * euler_tour_size + last + 1 - (1u << level)];
+	return blocks[dominator_depth[y] < dominator_depth[x] ? y : x];
 }
 
 void CFG::build_immediate_dominators()
 {
-	// Traverse the post-order in reverse and build up the immediate dominator tree.
-	fill(begin(immediate_dominators), end(immediate_dominators), 0);
-	immediate_dominators[func.entry_block] = func.entry_block;
+	// Semi-NCA, working on the pre-order numbers of the depth-first spanning tree.
+	// The semidominator of every block is found Lengauer-Tarjan style with path compression,
+	// then the immediate dominator is the nearest ancestor of the tree parent which is not below the semidominator.
+	uint32_t count = uint32_t(pre_order.size());
+	vector<uint32_t> pre_number(blocks.size(), Invalid);
+	for (uint32_t i = 0; i < count; i++)
+		pre_number[pre_order[i]] = i;
 
-	for (auto i = post_order.size(); i; i--)
+	vector<uint32_t> parent(count);
+	vector<uint32_t> semi(count);
+	vector<uint32_t> label(count);
+	vector<uint32_t> ancestor(count, Invalid);
+	vector<uint32_t> idom(count);
+	for (uint32_t i = 0; i < count; i++)
 	{
-		uint32_t block = post_order[i - 1];
-		auto &pred = preceding_edges[block];
-		if (pred.empty()) // This is for the entry block, but we've already set up the dominators.
-			continue;
+		parent[i] = i ? pre_number[dfs_parents[pre_order[i]]] : 0;
+		semi[i] = i;
+		label[i] = i;
+	}
+
+	// Finds the block with the smallest semidominator on the forest path above v.
+	// The path is compressed iteratively rather than recursively.
+	vector<uint32_t> path;
+	const auto eval = [&](uint32_t v) -> uint32_t {
+		if (ancestor[v] == Invalid)
+			return v;
 
-		for (auto &edge : pred)
+		path.clear();
+		for (uint32_t u = v; ancestor[ancestor[u]] != Invalid; u = ancestor[u])
+			path.push_back(u);
+
+		for (auto itr = path.rbegin(); itr != path.rend(); ++itr)
 		{
-			if (immediate_dominators[block])
-			{
-				assert(immediate_dominators[edge]);
-				immediate_dominators[block] = update_common_dominator(block, edge);
-			}
-			else
-				immediate_dominators[block] = edge;
+			uint32_t u = *itr;
+			uint32_t a = ancestor[u];
+			if (semi[label[a]] < semi[label[u]])
+				label[u] = label[a];
+			ancestor[u] = ancestor[a];
 		}
+		return label[v];
+	};
+
+	for (uint32_t w = count; w-- > 1;)
+	{
+		uint32_t block = pre_order[w];
+		for (uint32_t j = preceding_offsets[block]; j < preceding_offsets[block + 1]; j++)
+		{
+			uint32_t u = eval(pre_number[preceding_edges[j]]);
+			if (semi[u] < semi[w])
+				semi[w] = semi[u];
+		}
+		ancestor[w] = parent[w];
 	}
+
+	idom[0] = 0;
+	for (uint32_t w = 1; w < count; w++)
+	{
+		uint32_t dominator = parent[w];
+		while (dominator > semi[w])
+			dominator = idom[dominator];
+		idom[w] = dominator;
+	}
+
+	immediate_dominators.assign(blocks.size(), Invalid);
+	for (uint32_t i = 0; i < count; i++)
+		immediate_dominators[pre_order[i]] = pre_order[idom[i]];
+
+	build_dominator_tree();
 }
 
-bool CFG::is_back_edge(uint32_t to) const
+void CFG::build_dominator_tree()
 {
-	// We have a back edge if the visit order is set with the temporary magic value 0.
-	// Crossing edges will have already been recorded with a visit order.
-	return visit_order[to] == 0;
+	uint32_t block_count = uint32_t(blocks.size());
+	dominator_enter.assign(block_count, Invalid);
+	dominator_leave.assign(block_count, Invalid);
+	dominator_depth.assign(block_count, 0);
+	euler_first_visit.assign(block_count, Invalid);
+	euler_min_table.clear();
+	euler_tour_size = 0;
+
+	if (pre_order.empty())
+		return;
+
+	// Children of every block in the dominator tree, as compressed sparse rows.
+	// Visiting blocks in pre-order keeps the children in a stable order.
+	vector<uint32_t> child_offsets(block_count + 1, 0);
+	for (auto block : pre_order)
+		if (block != pre_order.front())
+			child_offsets[immediate_dominators[block] + 1]++;
+	for (uint32_t i = 1; i <= block_count; i++)
+		child_offsets[i] += child_offsets[i - 1];
+
+	vector<uint32_t> children(pre_order.size() - 1);
+	vector<uint32_t> fill(begin(child_offsets), end(child_offsets) - 1);
+	for (auto block : pre_order)
+		if (block != pre_order.front())
+			children[fill[immediate_dominators[block]]++] = block;
+
+	// Walk the tree with an explicit stack, numbering blocks and recording the Euler tour.
+	vector<uint32_t> tour;
+	tour.reserve(2 * pre_order.size() - 1);
+	vector<pair<uint32_t, uint32_t>> stack;
+	uint32_t counter = 0;
+
+	const auto enter = [&](uint32_t block, uint32_t depth) {
+		dominator_enter[block] = counter++;
+		dominator_depth[block] = depth;
+		euler_first_visit[block] = uint32_t(tour.size());
+		tour.push_back(block);
+		stack.emplace_back(block, child_offsets[block]);
+	};
+
+	enter(pre_order.front(), 0);
+	while (!stack.empty())
+	{
+		uint32_t block = stack.back().first;
+		uint32_t next = stack.back().second;
+		if (next < child_offsets[block + 1])
+		{
+			stack.back().second++;
+			enter(children[next], dominator_depth[block] + 1);
+			continue;
+		}
+
+		dominator_leave[block] = counter++;
+		stack.pop_back();
+		if (!stack.empty())
+			tour.push_back(stack.back().first);
+	}
+
+	// Sparse table over the tour. Row 0 is the tour itself.
+	euler_tour_size = uint32_t(tour.size());
+	uint32_t levels = 1;
+	while ((2u << (levels - 1)) <= euler_tour_size)
+		levels++;
+
+	euler_min_table.resize(size_t(levels) * euler_tour_size);
+	copy(begin(tour), end(tour), begin(euler_min_table));
+	for (uint32_t level = 1; level < levels; level++)
+	{
+		const uint32_t *prev = &euler_min_table[(level - 1) * euler_tour_size];
+		uint32_t *row = &euler_min_table[level * euler_tour_size];
+		uint32_t half = 1u << (level - 1);
+		for (uint32_t i = 0; i + (1u << level) <= euler_tour_size; i++)
+		{
+			uint32_t x = prev[i];
+			uint32_t y = prev[i + half];
+			row[i] = dominator_depth[y] < dominator_depth[x] ? y : x;
+		}
+	}
 }
 
-bool CFG::post_order_visit(uint32_t block_id)
+void CFG::get_branch_targets(uint32_t index, vector<uint32_t> &targets) const
 {
-	// If we have already branched to this block (back edge), stop recursion.
-	// If our branches are back-edges, we do not record them.
-	// We have to record crossing edges however.
-	if (visit_order[block_id] >= 0)
-		return !is_back_edge(block_id);
-
-	// Block back-edges from recursively revisiting ourselves.
-	visit_order[block_id] = 0;
+	const auto add_unique = [&](uint32_t block) {
+		uint32_t target = get_block_index(block);
+		if (find(begin(targets), end(targets), target) == end(targets))
+			targets.push_back(target);
+	};
 
-	// First visit our branch targets.
-	auto &block = compiler.get<SPIRBlock>(block_id);
+	targets.clear();
+	auto &block = compiler.get<SPIRBlock>(blocks[index]);
 	switch (block.terminator)
 	{
 	case SPIRBlock::Direct:
-		if (post_order_visit(block.next_block))
-			add_branch(block_id, block.next_block);
+		add_unique(block.next_block);
 		break;
 
 	case SPIRBlock::Select:
-		if (post_order_visit(block.true_block))
-			add_branch(block_id, block.true_block);
-		if (post_order_visit(block.false_block))
-			add_branch(block_id, block.false_block);
+		add_unique(block.true_block);
+		add_unique(block.false_block);
 		break;
 
 	case SPIRBlock::MultiSelect:
 		for (auto &target : block.cases)
-		{
-			if (post_order_visit(target.block))
-				add_branch(block_id, target.block);
-		}
-		if (block.default_block && post_order_visit(block.default_block))
-			add_branch(block_id, block.default_block);
+			add_unique(target.block);
+		if (block.default_block)
+			add_unique(block.default_block);
 		break;
 
 	default:
 		break;
 	}
+}
+
+void CFG::build_post_order_visit_order(vector<pair<uint32_t, uint32_t>> &back_edges)
+{
+	// Depth-first search with an explicit stack, so deeply nested control flow cannot overflow the call stack.
+	// Visit order -1 is unvisited, 0 is on the stack (so an edge to it is a back edge) and
+	// anything else is the post-order index, counting from one. Back edges are only recorded
+	// in back_edges, but crossing edges are regular edges.
+	struct Frame
+	{
+		uint32_t block;
+		uint32_t next_target;
+		vector<uint32_t> targets;
+	};
+
+	visit_order.assign(blocks.size(), -1);
+	dfs_parents.assign(blocks.size(), Invalid);
+	reverse_post_order.clear();
+	reverse_post_order.reserve(blocks.size());
+	pre_order.clear();
+	pre_order.reserve(blocks.size());
+
+	vector<pair<uint32_t, uint32_t>> edges;
+	vector<Frame> stack;
+	size_t depth = 0;
+	int visit_count = 0;
+
+	const auto push = [&](uint32_t block, uint32_t parent) {
+		visit_order[block] = 0;
+		dfs_parents[block] = parent;
+		pre_order.push_back(block);
+		if (depth == stack.size())
+			stack.emplace_back();
+		auto &frame = stack[depth++];
+		frame.block = block;
+		frame.next_target = 0;
+		get_branch_targets(block, frame.targets);
+	};
+
+	push(get_block_index(func.entry_block), Invalid);
+	while (depth)
+	{
+		auto &frame = stack[depth - 1];
+		if (frame.next_target < frame.targets.size())
+		{
+			uint32_t from = frame.block;
+			uint32_t to = frame.targets[frame.next_target++];
+			if (visit_order[to] < 0)
+				push(to, from);
+			else if (visit_order[to] > 0)
+				edges.emplace_back(from, to);
+			else
+				back_edges.emplace_back(from, to);
+			continue;
+		}
+
+		// All our branch targets are done, so visit ourselves.
+		uint32_t block = frame.block;
+		visit_order[block] = ++visit_count;
+		reverse_post_order.push_back(block);
+
+		// Our parent branched here.
+		depth--;
+		if (depth)
+			edges.emplace_back(stack[depth - 1].block, block);
+	}
 
-	// Then visit ourselves. Start counting at one, to let 0 be a magic value for testing back vs. crossing edges.
-	visit_order[block_id] = ++visit_count;
-	post_order.push_back(block_id);
-	return true;
+	reverse(begin(reverse_post_order), end(reverse_post_order));
+	build_edge_arrays(edges);
 }
 
-void CFG::build_post_order_visit_order()
+// Counting sorts the edges by source (or by target), filling one row of targets (or sources) per block.
+// This is stable, so every row keeps the order in which the edges were found.
+static void build_rows(vector<uint32_t> &offsets, vector<uint32_t> &targets,
+                       const vector<pair<uint32_t, uint32_t>> &edges, size_t block_count, bool by_target)
 {
-	uint32_t block = func.entry_block;
-	visit_count = 0;
-	fill(begin(visit_order), end(visit_order), -1);
-	post_order.clear();
-	post_order_visit(block);
+	offsets.assign(block_count + 1, 0);
+	for (auto &edge : edges)
+		offsets[(by_target ? edge.second : edge.first) + 1]++;
+	for (size_t i = 1; i < offsets.size(); i++)
+		offsets[i] += offsets[i - 1];
+
+	vector<uint32_t> fill(begin(offsets), end(offsets) - 1);
+	targets.resize(edges.size());
+	for (auto &edge : edges)
+	{
+		if (by_target)
+			targets[fill[edge.second]++] = edge.first;
+		else
+			targets[fill[edge.first]++] = edge.second;
+	}
 }
 
-void CFG::add_branch(uint32_t from, uint32_t to)
+void CFG::build_edge_arrays(const vector<pair<uint32_t, uint32_t>> &edges)
 {
-	const auto add_unique = [](vector<uint32_t> &l, uint32_t value) {
-		auto itr = find(begin(l), end(l), value);
-		if (itr == end(l))
-			l.push_back(value);
-	};
-	add_unique(preceding_edges[to], from);
-	add_unique(succeeding_edges[from], to);
+	build_rows(preceding_offsets, preceding_edges, edges, blocks.size(), true);
+	build_rows(succeeding_offsets, succeeding_edges, edges, blocks.size(), false);
+}
+
+void CFG::build_dominance_frontiers(const vector<pair<uint32_t, uint32_t>> &back_edges)
+{
+	// Loop headers are join points of their back edges, so the predecessors here include them.
+	const vector<uint32_t> *pred_offsets = &preceding_offsets;
+	const vector<uint32_t> *preds = &preceding_edges;
+	vector<uint32_t> all_pred_offsets;
+	vector<uint32_t> all_preds;
+	if (!back_edges.empty())
+	{
+		vector<pair<uint32_t, uint32_t>> edges;
+		edges.reserve(preceding_edges.size() + back_edges.size());
+		for (uint32_t block = 0; block < uint32_t(blocks.size()); block++)
+			for (uint32_t i = preceding_offsets[block]; i < preceding_offsets[block + 1]; i++)
+				edges.emplace_back(preceding_edges[i], block);
+		edges.insert(end(edges), begin(back_edges), end(back_edges));
+		build_rows(all_pred_offsets, all_preds, edges, blocks.size(), true);
+		pred_offsets = &all_pred_offsets;
+		preds = &all_preds;
+	}
+
+	// A join point is in the frontier of every block on the dominator tree path from each of its predecessors
+	// up to, but not including, its immediate dominator.
+	// Predecessors sharing part of that path would add the join point twice, so remember the last one added.
+	vector<pair<uint32_t, uint32_t>> frontier;
+	vector<uint32_t> last_added(blocks.size(), Invalid);
+
+	for (auto block : reverse_post_order)
+	{
+		uint32_t pred_begin = (*pred_offsets)[block];
+		uint32_t pred_end = (*pred_offsets)[block + 1];
+		if (pred_end - pred_begin < 2)
+			continue;
+
+		for (uint32_t i = pred_begin; i < pred_end; i++)
+		{
+			for (uint32_t runner = (*preds)[i]; runner != immediate_dominators[block];
+			     runner = immediate_dominators[runner])
+			{
+				if (last_added[runner] == block)
+					break;
+				last_added[runner] = block;
+				frontier.emplace_back(runner, block);
+			}
+		}
+	}
+
+	build_rows(frontier_offsets, frontier_edges, frontier, blocks.size(), false);
 }
 
 DominatorBuilder::DominatorBuilder(const CFG &cfg_)
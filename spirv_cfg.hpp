@@ -22,9 +22,92 @@
 
 namespace spirv_cross
 {
+// Control flow graph of a single function.
+// Blocks are numbered 0..N-1 in the order of SPIRFunction::blocks, so all per-block state scales with
+// the size of the function rather than the ID bound of the module. The public interface still takes
+// and returns block IDs.
+// Control flow is expected to be structured as SPIR-V requires, so every back edge branches to a loop header.
 class CFG
 {
 public:
+	// A list of blocks, such as the blocks on one side of a block's edges or a traversal order.
+	// A view into one of the CFG's flat index arrays, which yields block IDs.
+	class BlockList
+	{
+	public:
+		class const_iterator
+		{
+		public:
+			const_iterator(const uint32_t *itr_, const uint32_t *blocks_)
+			    : itr(itr_)
+			    , blocks(blocks_)
+			{
+			}
+
+			uint32_t operator*() const
+			{
+				return blocks[*itr];
+			}
+
+			const_iterator &operator++()
+			{
+				++itr;
+				return *this;
+			}
+
+			bool operator!=(const const_iterator &other) const
+			{
+				return itr != other.itr;
+			}
+
+		private:
+			const uint32_t *itr;
+			const uint32_t *blocks;
+		};
+
+		BlockList(const uint32_t *begin_, const uint32_t *end_, const uint32_t *blocks_)
+		    : first(begin_)
+		    , last(end_)
+		    , blocks(blocks_)
+		{
+		}
+
+		size_t size() const
+		{
+			return size_t(last - first);
+		}
+
+		bool empty() const
+		{
+			return first == last;
+		}
+
+		uint32_t operator[](size_t index) const
+		{
+			return blocks[first[index]];
+		}
+
+		uint32_t front() const
+		{
+			return blocks[*first];
+		}
+
+		const_iterator begin() const
+		{
+			return const_iterator(first, blocks);
+		}
+
+		const_iterator end() const
+		{
+			return const_iterator(last, blocks);
+		}
+
+	private:
+		const uint32_t *first;
+		const uint32_t *last;
+		const uint32_t *blocks;
+	};
+
 	CFG(Compiler &compiler, const SPIRFunction &function);
 
 	Compiler &get_compiler()
@@ -42,55 +125,156 @@ public:
 		return func;
 	}
 
+	// Returns 0 for blocks which cannot be reached from the entry block.
 	uint32_t get_immediate_dominator(uint32_t block) const
 	{
-		return immediate_dominators[block];
+		uint32_t dominator = immediate_dominators[get_block_index(block)];
+		return dominator != Invalid ? blocks[dominator] : 0;
 	}
 
 	uint32_t get_visit_order(uint32_t block) const
 	{
-		int v = visit_order[block];
+		int v = visit_order[get_block_index(block)];
 		assert(v > 0);
 		return uint32_t(v);
 	}
 
+	// Returns true if every path from the entry block to b passes through a. A block dominates itself.
+	// Unreachable blocks neither dominate nor are dominated by anything.
+	bool dominates(uint32_t a, uint32_t b) const
+	{
+		uint32_t index_a = get_block_index(a);
+		uint32_t index_b = get_block_index(b);
+		if (immediate_dominators[index_a] == Invalid || immediate_dominators[index_b] == Invalid)
+			return false;
+		return dominator_enter[index_a] <= dominator_enter[index_b] &&
+		       dominator_leave[index_b] <= dominator_leave[index_a];
+	}
+
+	// The closest block which dominates both a and b. Both blocks must be reachable.
 	uint32_t find_common_dominator(uint32_t a, uint32_t b) const;
 
-	const std::vector<uint32_t> &get_preceding_edges(uint32_t block) const
+	// Edge lists keep the order in which the edges were found.
+	// Back edges, i.e. branches to a loop header from inside its loop, are left out.
+	BlockList get_preceding_edges(uint32_t block) const
+	{
+		uint32_t index = get_block_index(block);
+		return BlockList(preceding_edges.data() + preceding_offsets[index],
+		                 preceding_edges.data() + preceding_offsets[index + 1], blocks.data());
+	}
+
+	BlockList get_succeeding_edges(uint32_t block) const
 	{
-		return preceding_edges[block];
+		uint32_t index = get_block_index(block);
+		return BlockList(succeeding_edges.data() + succeeding_offsets[index],
+		                 succeeding_edges.data() + succeeding_offsets[index + 1], blocks.data());
 	}
 
-	const std::vector<uint32_t> &get_succeeding_edges(uint32_t block) const
+	// The reachable blocks, each before all of its successors. The entry block comes first.
+	BlockList get_reverse_post_order() const
 	{
-		return succeeding_edges[block];
+		return BlockList(reverse_post_order.data(), reverse_post_order.data() + reverse_post_order.size(),
+		                 blocks.data());
 	}
 
+	// The blocks where the dominance of block ends: blocks which block does not strictly dominate,
+	// but which have a predecessor that block dominates. Empty for unreachable blocks.
+	// Unlike the edge lists, this takes back edges into account, so a loop header is in the frontier
+	// of every block of its loop which can branch back to it, itself included.
+	BlockList get_dominance_frontier(uint32_t block) const
+	{
+		uint32_t index = get_block_index(block);
+		return BlockList(frontier_edges.data() + frontier_offsets[index],
+		                 frontier_edges.data() + frontier_offsets[index + 1], blocks.data());
+	}
+
+	// Calls op once for every block reachable from block without taking back edges, block itself included.
+	// Blocks shared by several paths are only visited the first time they are found.
 	template <typename Op>
 	void walk_from(uint32_t block, const Op &op) const
 	{
-		op(block);
-		for (auto b : succeeding_edges[block])
-			walk_from(b, op);
+		std::vector<bool> visited(blocks.size());
+		std::vector<uint32_t> stack;
+
+		uint32_t index = get_block_index(block);
+		visited[index] = true;
+		stack.push_back(index);
+		while (!stack.empty())
+		{
+			index = stack.back();
+			stack.pop_back();
+			op(blocks[index]);
+
+			// Push in reverse, so successors are walked in edge order.
+			for (uint32_t i = succeeding_offsets[index + 1]; i > succeeding_offsets[index]; i--)
+			{
+				uint32_t next = succeeding_edges[i - 1];
+				if (!visited[next])
+				{
+					visited[next] = true;
+					stack.push_back(next);
+				}
+			}
+		}
+	}
+
+	// Maps a block ID to its index in the function. The block must belong to the function.
+	uint32_t get_block_index(uint32_t block) const
+	{
+		auto itr = block_indices.find(block);
+		assert(itr != block_indices.end());
+		return itr->second;
 	}
 
 private:
+	enum : uint32_t
+	{
+		Invalid = ~0u
+	};
+
 	Compiler &compiler;
 	const SPIRFunction &func;
-	std::vector<std::vector<uint32_t>> preceding_edges;
-	std::vector<std::vector<uint32_t>> succeeding_edges;
-	std::vector<uint32_t> immediate_dominators;
+
+	// Block ID of each block index, and the reverse.
+	std::vector<uint32_t> blocks;
+	std::unordered_map<uint32_t, uint32_t> block_indices;
+
+	// Compressed sparse rows: the edges of block i are [offsets[i], offsets[i + 1]) in the edge array.
+	std::vector<uint32_t> preceding_offsets;
+	std::vector<uint32_t> preceding_edges;
+	std::vector<uint32_t> succeeding_offsets;
+	std::vector<uint32_t> succeeding_edges;
+
 	std::vector<int> visit_order;
-	std::vector<uint32_t> post_order;
+	std::vector<uint32_t> reverse_post_order;
 
-	void add_branch(uint32_t from, uint32_t to);
-	void build_post_order_visit_order();
-	void build_immediate_dominators();
-	bool post_order_visit(uint32_t block);
-	uint32_t visit_count = 0;
+	// Depth-first spanning tree of the reachable blocks.
+	std::vector<uint32_t> pre_order;
+	std::vector<uint32_t> dfs_parents;
 
-	uint32_t update_common_dominator(uint32_t a, uint32_t b);
-	bool is_back_edge(uint32_t to) const;
+	// Dominator tree. Enter and leave are the pre- and post-order numbers of a depth-first walk over the tree,
+	// so a dominates b exactly when b's interval nests inside a's.
+	std::vector<uint32_t> immediate_dominators;
+	std::vector<uint32_t> dominator_enter;
+	std::vector<uint32_t> dominator_leave;
+
+	// Lowest common ancestor queries on the dominator tree are range minimum queries over its Euler tour,
+	// answered in constant time by a sparse table. Row k holds the shallowest block of every 2^k range.
+	std::vector<uint32_t> dominator_depth;
+	std::vector<uint32_t> euler_first_visit;
+	std::vector<uint32_t> euler_min_table;
+	uint32_t euler_tour_size = 0;
+
+	// Dominance frontiers, as compressed sparse rows like the edges.
+	std::vector<uint32_t> frontier_offsets;
+	std::vector<uint32_t> frontier_edges;
+
+	void build_post_order_visit_order(std::vector<std::pair<uint32_t, uint32_t>> &back_edges);
+	void build_edge_arrays(const std::vector<std::pair<uint32_t, uint32_t>> &edges);
+	void build_immediate_dominators();
+	void build_dominator_tree();
+	void build_dominance_frontiers(const std::vector<std::pair<uint32_t, uint32_t>> &back_edges);
+	void get_branch_targets(uint32_t index, std::vector<uint32_t> &targets) const;
 };
 
 class DominatorBuilder
@@ -17,11 +17,23 @@
 #ifndef SPIRV_CROSS_COMMON_HPP
 #define SPIRV_CROSS_COMMON_HPP
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <functional>
-#include <locale>
-#include <sstream>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 namespace spirv_cross
 {
@@ -55,16 +67,557 @@ public:
 #define SPIRV_CROSS_THROW(x) throw CompilerError(x)
 #endif
 
+// Shortest round-trip formatting of floating point literals.
+// This is Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers"),
+// which works entirely on 64-bit integers and does not depend on the C locale.
+// The digits always parse back to the exact same value. In very rare cases they are
+// not the shortest such representation, but never longer than what %.17g would produce.
 namespace inner
 {
+struct DiyFloat
+{
+	uint64_t f;
+	int e;
+};
+
+inline DiyFloat diy_sub(DiyFloat x, DiyFloat y)
+{
+	return { x.f - y.f, x.e };
+}
+
+// Upper 64 bits of the 128-bit product, rounded.
+inline DiyFloat diy_mul(DiyFloat x, DiyFloat y)
+{
+	uint64_t u_lo = x.f & 0xffffffffu;
+	uint64_t u_hi = x.f >> 32;
+	uint64_t v_lo = y.f & 0xffffffffu;
+	uint64_t v_hi = y.f >> 32;
+
+	uint64_t p0 = u_lo * v_lo;
+	uint64_t p1 = u_lo * v_hi;
+	uint64_t p2 = u_hi * v_lo;
+	uint64_t p3 = u_hi * v_hi;
+
+	uint64_t q = (p0 >> 32) + (p1 & 0xffffffffu) + (p2 & 0xffffffffu);
+	q += uint64_t(1) << 31;
+
+	return { p3 + (p1 >> 32) + (p2 >> 32) + (q >> 32), x.e + y.e + 64 };
+}
+
+inline DiyFloat diy_normalize(DiyFloat x)
+{
+	while ((x.f >> 63) == 0)
+	{
+		x.f <<= 1;
+		x.e--;
+	}
+	return x;
+}
+
+// Decomposes value into its significand and the two midpoints to its neighbors.
+// Boundaries are computed in the precision of T, so floats get float-length output.
+template <typename T, typename Bits>
+inline void float_boundaries(T value, DiyFloat &v, DiyFloat &minus, DiyFloat &plus)
+{
+	static_assert(sizeof(T) == sizeof(Bits), "Bits must have the same size as T.");
+	const int precision = std::numeric_limits<T>::digits;
+	const int bias = std::numeric_limits<T>::max_exponent - 1 + (precision - 1);
+	const int min_exp = 1 - bias;
+	const uint64_t hidden_bit = uint64_t(1) << (precision - 1);
+
+	Bits bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint64_t fraction = uint64_t(bits) & (hidden_bit - 1);
+	int exponent = int(uint64_t(bits) >> (precision - 1)) & ((1 << (sizeof(T) * 8 - precision)) - 1);
+
+	if (exponent == 0)
+		v = { fraction, min_exp };
+	else
+		v = { fraction + hidden_bit, exponent - bias };
+
+	// At a power of two, the gap to the next lower value is only half as large.
+	bool lower_closer = fraction == 0 && exponent > 1;
+	plus = diy_normalize({ 2 * v.f + 1, v.e - 1 });
+	if (lower_closer)
+		minus = { 4 * v.f - 1, v.e - 2 };
+	else
+		minus = { 2 * v.f - 1, v.e - 1 };
+	minus = { minus.f << (minus.e - plus.e), plus.e };
+	v = diy_normalize(v);
+}
+
+struct CachedPower
+{
+	uint64_t f;
+	int e;
+	int k;
+};
+
+// Returns c = 10^k such that multiplying a value with binary exponent e by c
+// yields a binary exponent in [-60, -32].
+inline CachedPower get_cached_power(int e)
+{
+	// Normalized 10^k for k = -300, -292, ..., 324.
+	static const CachedPower powers[] = {
+		{ 0xAB70FE17C79AC6CA, -1060, -300 },
+		{ 0xFF77B1FCBEBCDC4F, -1034, -292 },
+		{ 0xBE5691EF416BD60C, -1007, -284 },
+		{ 0x8DD01FAD907FFC3C, -980, -276 },
+		{ 0xD3515C2831559A83, -954, -268 },
+		{ 0x9D71AC8FADA6C9B5, -927, -260 },
+		{ 0xEA9C227723EE8BCB, -901, -252 },
+		{ 0xAECC49914078536D, -874, -244 },
+		{ 0x823C12795DB6CE57, -847, -236 },
+		{ 0xC21094364DFB5637, -821, -228 },
+		{ 0x9096EA6F3848984F, -794, -220 },
+		{ 0xD77485CB25823AC7, -768, -212 },
+		{ 0xA086CFCD97BF97F4, -741, -204 },
+		{ 0xEF340A98172AACE5, -715, -196 },
+		{ 0xB23867FB2A35B28E, -688, -188 },
+		{ 0x84C8D4DFD2C63F3B, -661, -180 },
+		{ 0xC5DD44271AD3CDBA, -635, -172 },
+		{ 0x936B9FCEBB25C996, -608, -164 },
+		{ 0xDBAC6C247D62A584, -582, -156 },
+		{ 0xA3AB66580D5FDAF6, -555, -148 },
+		{ 0xF3E2F893DEC3F126, -529, -140 },
+		{ 0xB5B5ADA8AAFF80B8, -502, -132 },
+		{ 0x87625F056C7C4A8B, -475, -124 },
+		{ 0xC9BCFF6034C13053, -449, -116 },
+		{ 0x964E858C91BA2655, -422, -108 },
+		{ 0xDFF9772470297EBD, -396, -100 },
+		{ 0xA6DFBD9FB8E5B88F, -369, -92 },
+		{ 0xF8A95FCF88747D94, -343, -84 },
+		{ 0xB94470938FA89BCF, -316, -76 },
+		{ 0x8A08F0F8BF0F156B, -289, -68 },
+		{ 0xCDB02555653131B6, -263, -60 },
+		{ 0x993FE2C6D07B7FAC, -236, -52 },
+		{ 0xE45C10C42A2B3B06, -210, -44 },
+		{ 0xAA242499697392D3, -183, -36 },
+		{ 0xFD87B5F28300CA0E, -157, -28 },
+		{ 0xBCE5086492111AEB, -130, -20 },
+		{ 0x8CBCCC096F5088CC, -103, -12 },
+		{ 0xD1B71758E219652C, -77, -4 },
+		{ 0x9C40000000000000, -50, 4 },
+		{ 0xE8D4A51000000000, -24, 12 },
+		{ 0xAD78EBC5AC620000, 3, 20 },
+		{ 0x813F3978F8940984, 30, 28 },
+		{ 0xC097CE7BC90715B3, 56, 36 },
+		{ 0x8F7E32CE7BEA5C70, 83, 44 },
+		{ 0xD5D238A4ABE98068, 109, 52 },
+		{ 0x9F4F2726179A2245, 136, 60 },
+		{ 0xED63A231D4C4FB27, 162, 68 },
+		{ 0xB0DE65388CC8ADA8, 189, 76 },
+		{ 0x83C7088E1AAB65DB, 216, 84 },
+		{ 0xC45D1DF942711D9A, 242, 92 },
+		{ 0x924D692CA61BE758, 269, 100 },
+		{ 0xDA01EE641A708DEA, 295, 108 },
+		{ 0xA26DA3999AEF774A, 322, 116 },
+		{ 0xF209787BB47D6B85, 348, 124 },
+		{ 0xB454E4A179DD1877, 375, 132 },
+		{ 0x865B86925B9BC5C2, 402, 140 },
+		{ 0xC83553C5C8965D3D, 428, 148 },
+		{ 0x952AB45CFA97A0B3, 455, 156 },
+		{ 0xDE469FBD99A05FE3, 481, 164 },
+		{ 0xA59BC234DB398C25, 508, 172 },
+		{ 0xF6C69A72A3989F5C, 534, 180 },
+		{ 0xB7DCBF5354E9BECE, 561, 188 },
+		{ 0x88FCF317F22241E2, 588, 196 },
+		{ 0xCC20CE9BD35C78A5, 614, 204 },
+		{ 0x98165AF37B2153DF, 641, 212 },
+		{ 0xE2A0B5DC971F303A, 667, 220 },
+		{ 0xA8D9D1535CE3B396, 694, 228 },
+		{ 0xFB9B7CD9A4A7443C, 720, 236 },
+		{ 0xBB764C4CA7A44410, 747, 244 },
+		{ 0x8BAB8EEFB6409C1A, 774, 252 },
+		{ 0xD01FEF10A657842C, 800, 260 },
+		{ 0x9B10A4E5E9913129, 827, 268 },
+		{ 0xE7109BFBA19C0C9D, 853, 276 },
+		{ 0xAC2820D9623BF429, 880, 284 },
+		{ 0x80444B5E7AA7CF85, 907, 292 },
+		{ 0xBF21E44003ACDD2D, 933, 300 },
+		{ 0x8E679C2F5E44FF8F, 960, 308 },
+		{ 0xD433179D9C8CB841, 986, 316 },
+		{ 0x9E19DB92B4E31BA9, 1013, 324 },
+	};
+
+	const int alpha = -60;
+	const int min_decimal_exp = -300;
+	const int decimal_step = 8;
+
+	// k = ceil((alpha - e - 1) * log10(2))
+	int f = alpha - e - 1;
+	int k = (f * 78913) / (1 << 18) + int(f > 0);
+	int index = (-min_decimal_exp + k + (decimal_step - 1)) / decimal_step;
+	return powers[index];
+}
+
+inline void grisu2_round(char *buf, int len, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t ten_k)
+{
+	// Move the last digit towards w as long as we stay inside the rounding interval.
+	while (rest < dist && delta - rest >= ten_k && (rest + ten_k < dist || dist - rest > rest + ten_k - dist))
+	{
+		buf[len - 1]--;
+		rest += ten_k;
+	}
+}
+
+// Emits the digits of w such that the result lies in [minus, plus].
+// The value of the output is buf * 10^decimal_exponent.
+inline void grisu2_digits(char *buf, int &len, int &decimal_exponent, DiyFloat minus, DiyFloat w, DiyFloat plus)
+{
+	const DiyFloat one = { uint64_t(1) << -plus.e, plus.e };
+
+	uint32_t p1 = uint32_t(plus.f >> -one.e);
+	uint64_t p2 = plus.f & (one.f - 1);
+	uint64_t delta = diy_sub(plus, minus).f;
+	uint64_t dist = diy_sub(plus, w).f;
+
+	// Integral part.
+	uint32_t pow10 = 1;
+	int n = 1;
+	while (n < 10 && p1 >= pow10 * 10)
+	{
+		pow10 *= 10;
+		n++;
+	}
+
+	while (n > 0)
+	{
+		buf[len++] = char('0' + p1 / pow10);
+		p1 %= pow10;
+		n--;
+
+		uint64_t rest = (uint64_t(p1) << -one.e) + p2;
+		if (rest <= delta)
+		{
+			decimal_exponent += n;
+			grisu2_round(buf, len, dist, delta, rest, uint64_t(pow10) << -one.e);
+			return;
+		}
+		pow10 /= 10;
+	}
+
+	// Fractional part.
+	int m = 0;
+	for (;;)
+	{
+		p2 *= 10;
+		buf[len++] = char('0' + (p2 >> -one.e));
+		p2 &= one.f - 1;
+		m++;
+
+		delta *= 10;
+		dist *= 10;
+		if (p2 <= delta)
+			break;
+	}
+
+	decimal_exponent -= m;
+	grisu2_round(buf, len, dist, delta, p2, one.f);
+}
+
+template <typename T, typename Bits>
+inline size_t format_float(char *buf, T value)
+{
+	char *out = buf;
+	if (std::signbit(value))
+	{
+		*out++ = '-';
+		value = -value;
+	}
+
+	// Not valid literals in any backend, but keep them recognizable.
+	if (std::isinf(value) || std::isnan(value))
+	{
+		memcpy(out, std::isinf(value) ? "inf.0" : "nan.0", 5);
+		return size_t(out - buf) + 5;
+	}
+
+	if (value == T(0))
+	{
+		memcpy(out, "0.0", 3);
+		return size_t(out - buf) + 3;
+	}
+
+	DiyFloat v, minus, plus;
+	float_boundaries<T, Bits>(value, v, minus, plus);
+
+	CachedPower cached = get_cached_power(plus.e);
+	DiyFloat c = { cached.f, cached.e };
+	DiyFloat w = diy_mul(v, c);
+	DiyFloat w_minus = diy_mul(minus, c);
+	DiyFloat w_plus = diy_mul(plus, c);
+
+	// Shrink the interval by one unit on both ends to stay clear of rounding errors in diy_mul.
+	char digits[20];
+	int len = 0;
+	int decimal_exponent = -cached.k;
+	grisu2_digits(digits, len, decimal_exponent, { w_minus.f + 1, w_minus.e }, w, { w_plus.f - 1, w_plus.e });
+
+	// Position of the decimal point relative to the first digit.
+	int point = len + decimal_exponent;
+
+	if (point > 0 && point <= 17)
+	{
+		// 1234500.0 or 123.45
+		if (len <= point)
+		{
+			memcpy(out, digits, size_t(len));
+			out += len;
+			memset(out, '0', size_t(point - len));
+			out += point - len;
+			memcpy(out, ".0", 2);
+			out += 2;
+		}
+		else
+		{
+			memcpy(out, digits, size_t(point));
+			out += point;
+			*out++ = '.';
+			memcpy(out, digits + point, size_t(len - point));
+			out += len - point;
+		}
+	}
+	else if (point <= 0 && point > -4)
+	{
+		// 0.00012345
+		*out++ = '0';
+		*out++ = '.';
+		memset(out, '0', size_t(-point));
+		out += -point;
+		memcpy(out, digits, size_t(len));
+		out += len;
+	}
+	else
+	{
+		// 1.2345e+20 or 1e-07
+		*out++ = digits[0];
+		if (len > 1)
+		{
+			*out++ = '.';
+			memcpy(out, digits + 1, size_t(len - 1));
+			out += len - 1;
+		}
+
+		int exponent = point - 1;
+		*out++ = 'e';
+		*out++ = exponent < 0 ? '-' : '+';
+		if (exponent < 0)
+			exponent = -exponent;
+		if (exponent >= 100)
+			*out++ = char('0' + exponent / 100);
+		*out++ = char('0' + (exponent / 10) % 10);
+		*out++ = char('0' + exponent % 10);
+	}
+
+	return size_t(out - buf);
+}
+}
+
+#ifdef SPIRV_CROSS_FLT_FMT
+#error "SPIRV_CROSS_FLT_FMT is no longer supported. Float literals are always printed with round-trip digits."
+#endif
+
+// Formats value into buf, which must hold at least 32 characters, and returns the length.
+// The output is locale independent and always contains a '.' or an exponent.
+inline size_t format_float(char *buf, float value)
+{
+	return inner::format_float<float, uint32_t>(buf, value);
+}
+
+inline size_t format_float(char *buf, double value)
+{
+	return inner::format_float<double, uint64_t>(buf, value);
+}
+
+// Append-only text buffer used for emitting source and joining expressions.
+// Small strings live entirely in the inline stack buffer. Larger ones spill into a heap
+// std::string which grows geometrically and is kept across reset(), so a repeated pass
+// writes into storage which is already large enough, and release() can move it out.
+template <size_t StackSize = 4096, size_t MinHeapSize = 4096>
+class StringStream
+{
+public:
+	StringStream()
+	    : buffer(stack_buffer)
+	    , capacity(StackSize)
+	{
+	}
+
+	StringStream(const StringStream &) = delete;
+	StringStream &operator=(const StringStream &) = delete;
+
+	// Discards all text. Heap storage is kept around for the next round of appends.
+	void reset()
+	{
+		offset = 0;
+	}
+
+	// Number of bytes appended since the last reset().
+	size_t size() const
+	{
+		return offset;
+	}
+
+	std::string str() const
+	{
+		return std::string(buffer, offset);
+	}
+
+	// Hands out the text and resets the stream. Text which spilled to the heap is moved out
+	// without copying, at the cost of the heap storage, which the next spill has to allocate again.
+	std::string release()
+	{
+		if (buffer == stack_buffer)
+		{
+			std::string ret(buffer, offset);
+			offset = 0;
+			return ret;
+		}
+
+		heap.resize(offset);
+		std::string ret = std::move(heap);
+		heap = std::string();
+		buffer = stack_buffer;
+		capacity = StackSize;
+		offset = 0;
+		return ret;
+	}
+
+	void append(const char *s, size_t len)
+	{
+		if (capacity - offset < len)
+			grow(offset + len);
+
+		memcpy(buffer + offset, s, len);
+		offset += len;
+	}
+
+	void append(char c, size_t count)
+	{
+		if (capacity - offset < count)
+			grow(offset + count);
+
+		memset(buffer + offset, c, count);
+		offset += count;
+	}
+
+	StringStream &operator<<(const std::string &s)
+	{
+		append(s.data(), s.size());
+		return *this;
+	}
+
+	StringStream &operator<<(const char *s)
+	{
+		append(s, strlen(s));
+		return *this;
+	}
+
+	StringStream &operator<<(char c)
+	{
+		append(&c, 1);
+		return *this;
+	}
+
+	StringStream &operator<<(bool b)
+	{
+		return *this << (b ? '1' : '0');
+	}
+
+	template <typename T>
+	typename std::enable_if<std::is_integral<T>::value, StringStream &>::type operator<<(T t)
+	{
+		append_integer(t, std::is_signed<T>());
+		return *this;
+	}
+
+	template <typename T>
+	typename std::enable_if<std::is_enum<T>::value, StringStream &>::type operator<<(T t)
+	{
+		return *this << static_cast<typename std::underlying_type<T>::type>(t);
+	}
+
+	StringStream &operator<<(float f)
+	{
+		char buf[32];
+		append(buf, format_float(buf, f));
+		return *this;
+	}
+
+	StringStream &operator<<(double d)
+	{
+		char buf[32];
+		append(buf, format_float(buf, d));
+		return *this;
+	}
+
+private:
+	char *buffer;
+	size_t offset = 0;
+	size_t capacity;
+	std::string heap;
+	char stack_buffer[StackSize];
+
+	void grow(size_t minimum)
+	{
+		size_t size = capacity * 2;
+		if (size < MinHeapSize)
+			size = MinHeapSize;
+		if (size < minimum)
+			size = minimum;
+
+		// Once on the heap, resize() moves the text along. The stack buffer has to be copied by hand.
+		bool spilled = buffer != stack_buffer;
+		heap.resize(size);
+		if (!spilled)
+			memcpy(&heap[0], stack_buffer, offset);
+
+		buffer = &heap[0];
+		capacity = size;
+	}
+
+	template <typename T>
+	void append_integer(T t, std::true_type)
+	{
+		typedef typename std::make_unsigned<T>::type U;
+		if (t < 0)
+		{
+			*this << '-';
+			append_integer(U(U(0) - U(t)), std::false_type());
+		}
+		else
+			append_integer(U(t), std::false_type());
+	}
+
+	template <typename T>
+	void append_integer(T t, std::false_type)
+	{
+		char buf[24];
+		char *end = buf + sizeof(buf);
+		char *p = end;
+		do
+		{
+			*--p = char('0' + t % 10);
+			t /= 10;
+		} while (t);
+		append(p, size_t(end - p));
+	}
+};
+
+namespace inner
+{
+// Most joined expressions are short, so keep the stack footprint of join() small.
+typedef StringStream<256, 512> JoinStream;
+
 template <typename T>
-void join_helper(std::ostringstream &stream, T &&t)
+void join_helper(JoinStream &stream, T &&t)
 {
 	stream << std::forward<T>(t);
 }
 
 template <typename T, typename... Ts>
-void join_helper(std::ostringstream &stream, T &&t, Ts &&... ts)
+void join_helper(JoinStream &stream, T &&t, Ts &&... ts)
 {
 	stream << std::forward<T>(t);
 	join_helper(stream, std::forward<Ts>(ts)...);
@@ -75,9 +628,9 @@ void join_helper(std::ostringstream &stream, T &&t, Ts &&... ts)
 template <typename... Ts>
 std::string join(Ts &&... ts)
 {
-	std::ostringstream stream;
+	inner::JoinStream stream;
 	inner::join_helper(stream, std::forward<Ts>(ts)...);
-	return stream.str();
+	return stream.release();
 }
 
 inline std::string merge(const std::vector<std::string> &list)
@@ -98,47 +651,315 @@ inline std::string convert_to_string(T &&t)
 	return std::to_string(std::forward<T>(t));
 }
 
-// Allow implementations to set a convenient standard precision
-#ifndef SPIRV_CROSS_FLT_FMT
-#define SPIRV_CROSS_FLT_FMT "%.32g"
-#endif
-
-#ifdef _MSC_VER
-#pragma warning(push)
-#pragma warning(disable: 4996)
-#endif
-
 inline std::string convert_to_string(float t)
 {
 	// std::to_string for floating point values is broken.
-	// Fallback to something more sane.
-	char buf[64];
-	sprintf(buf, SPIRV_CROSS_FLT_FMT, t);
-	// Ensure that the literal is float.
-	if (!strchr(buf, '.') && !strchr(buf, 'e'))
-		strcat(buf, ".0");
-	return buf;
+	// Print the shortest literal which still parses back to the exact same value.
+	char buf[32];
+	return std::string(buf, format_float(buf, t));
 }
 
 inline std::string convert_to_string(double t)
 {
-	// std::to_string for floating point values is broken.
-	// Fallback to something more sane.
-	char buf[64];
-	sprintf(buf, SPIRV_CROSS_FLT_FMT, t);
-	// Ensure that the literal is float.
-	if (!strchr(buf, '.') && !strchr(buf, 'e'))
-		strcat(buf, ".0");
-	return buf;
+	char buf[32];
+	return std::string(buf, format_float(buf, t));
 }
 
-#ifdef _MSC_VER
-#pragma warning(pop)
+// 128-bit result of a Hasher.
+struct HashValue
+{
+	uint64_t low;
+	uint64_t high;
+
+	bool operator==(const HashValue &other) const
+	{
+		return low == other.low && high == other.high;
+	}
+
+	bool operator!=(const HashValue &other) const
+	{
+		return !(*this == other);
+	}
+};
+
+// Hashes a stream of 32-bit words, used to build cache keys.
+// The low half is 64-bit FNV-1a over words, the high half an independent multiply-xorshift hash,
+// so an accidental collision needs both of them to collide at once.
+// Neither is cryptographic, so keys are no protection against deliberately crafted input.
+class Hasher
+{
+public:
+	void u32(uint32_t value)
+	{
+		a = (a ^ value) * 0x100000001b3ull;
+		b = (b ^ value) * 0x9e3779b97f4a7c15ull;
+		b ^= b >> 29;
+	}
+
+	void u64(uint64_t value)
+	{
+		u32(uint32_t(value));
+		u32(uint32_t(value >> 32));
+	}
+
+	void value(const HashValue &hash)
+	{
+		u64(hash.low);
+		u64(hash.high);
+	}
+
+	void string(const std::string &str)
+	{
+		u32(uint32_t(str.size()));
+		for (auto c : str)
+			u32(uint8_t(c));
+	}
+
+	void data(const uint32_t *words, size_t count)
+	{
+		u64(count);
+		for (size_t i = 0; i < count; i++)
+			u32(words[i]);
+	}
+
+	HashValue get() const
+	{
+		HashValue hash;
+		hash.low = a;
+		hash.high = b;
+		return hash;
+	}
+
+private:
+	uint64_t a = 0xcbf29ce484222325ull;
+	uint64_t b = 0x243f6a8885a308d3ull;
+};
+
+// Hashed first into every cache key.
+// Bump it with any change which can alter the output for the same input,
+// so that persistent caches never serve results from an older version.
+static const uint32_t kCompileHashVersion = 2;
+
+namespace inner
+{
+inline uint32_t count_trailing_zeros(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return uint32_t(__builtin_ctzll(value));
+#else
+	uint32_t count = 0;
+	while ((value & 1) == 0)
+	{
+		value >>= 1;
+		count++;
+	}
+	return count;
+#endif
+}
+
+inline uint32_t popcount(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return uint32_t(__builtin_popcountll(value));
+#else
+	value = value - ((value >> 1) & 0x5555555555555555ull);
+	value = (value & 0x3333333333333333ull) + ((value >> 2) & 0x3333333333333333ull);
+	value = (value + (value >> 4)) & 0x0f0f0f0f0f0f0f0full;
+	return uint32_t((value * 0x0101010101010101ull) >> 56);
 #endif
+}
+}
+
+// Set of IDs stored as one bit per ID. IDs are dense and bounded by the ID bound of the module,
+// so membership is a single bit test and set operations work a 64-bit word at a time,
+// in plain loops the compiler can vectorize. Storage grows on insert, so no bound is needed up front.
+// Iteration visits IDs in ascending order.
+class IDBitset
+{
+public:
+	class const_iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef uint32_t value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const uint32_t *pointer;
+		typedef uint32_t reference;
+
+		const_iterator(const IDBitset &set_, size_t id_)
+		    : set(&set_)
+		    , id(id_)
+		{
+			skip_unset();
+		}
+
+		uint32_t operator*() const
+		{
+			return uint32_t(id);
+		}
+
+		const_iterator &operator++()
+		{
+			id++;
+			skip_unset();
+			return *this;
+		}
+
+		const_iterator operator++(int)
+		{
+			auto ret = *this;
+			++*this;
+			return ret;
+		}
+
+		bool operator==(const const_iterator &other) const
+		{
+			return id == other.id;
+		}
+
+		bool operator!=(const const_iterator &other) const
+		{
+			return id != other.id;
+		}
+
+	private:
+		const IDBitset *set;
+		size_t id;
+
+		void skip_unset()
+		{
+			size_t limit = set->words.size() * 64;
+			while (id < limit)
+			{
+				uint64_t word = set->words[id / 64] >> (id & 63);
+				if (word)
+				{
+					id += inner::count_trailing_zeros(word);
+					return;
+				}
+				id = (id / 64 + 1) * 64;
+			}
+			id = limit;
+		}
+	};
+
+	IDBitset() = default;
+
+	// Reserves room for IDs below bound.
+	explicit IDBitset(uint32_t bound)
+	    : words((bound + 63) / 64)
+	{
+	}
+
+	size_t count(uint32_t id) const
+	{
+		size_t index = id / 64;
+		return index < words.size() ? size_t((words[index] >> (id & 63)) & 1) : 0;
+	}
+
+	// Returns true if id was not already in the set.
+	bool insert(uint32_t id)
+	{
+		size_t index = id / 64;
+		if (index >= words.size())
+			words.resize(index + 1);
+
+		uint64_t mask = 1ull << (id & 63);
+		bool inserted = (words[index] & mask) == 0;
+		words[index] |= mask;
+		return inserted;
+	}
+
+	void erase(uint32_t id)
+	{
+		size_t index = id / 64;
+		if (index < words.size())
+			words[index] &= ~(1ull << (id & 63));
+	}
+
+	// Keeps the storage, so refilling the set does not allocate.
+	void clear()
+	{
+		std::fill(std::begin(words), std::end(words), 0);
+	}
+
+	bool empty() const
+	{
+		for (auto word : words)
+			if (word)
+				return false;
+		return true;
+	}
+
+	size_t size() const
+	{
+		size_t total = 0;
+		for (auto word : words)
+			total += inner::popcount(word);
+		return total;
+	}
+
+	// this = this | other
+	void merge(const IDBitset &other)
+	{
+		if (other.words.size() > words.size())
+			words.resize(other.words.size());
+		for (size_t i = 0; i < other.words.size(); i++)
+			words[i] |= other.words[i];
+	}
+
+	// this = this & other
+	void intersect(const IDBitset &other)
+	{
+		size_t common = std::min(words.size(), other.words.size());
+		for (size_t i = 0; i < common; i++)
+			words[i] &= other.words[i];
+		std::fill(std::begin(words) + common, std::end(words), 0);
+	}
+
+	// this = this & ~other
+	void subtract(const IDBitset &other)
+	{
+		size_t common = std::min(words.size(), other.words.size());
+		for (size_t i = 0; i < common; i++)
+			words[i] &= ~other.words[i];
+	}
+
+	bool operator==(const IDBitset &other) const
+	{
+		auto &longer = words.size() > other.words.size() ? words : other.words;
+		size_t common = std::min(words.size(), other.words.size());
+		for (size_t i = 0; i < common; i++)
+			if (words[i] != other.words[i])
+				return false;
+		for (size_t i = common; i < longer.size(); i++)
+			if (longer[i])
+				return false;
+		return true;
+	}
+
+	bool operator!=(const IDBitset &other) const
+	{
+		return !(*this == other);
+	}
+
+	const_iterator begin() const
+	{
+		return const_iterator(*this, 0);
+	}
+
+	const_iterator end() const
+	{
+		return const_iterator(*this, words.size() * 64);
+	}
+
+private:
+	std::vector<uint64_t> words;
+};
 
 struct Instruction
 {
-	Instruction(const std::vector<uint32_t> &spirv, uint32_t &index);
+	Instruction(const uint32_t *spirv, size_t word_count, uint32_t &index);
 
 	uint16_t op;
 	uint16_t count;
@@ -166,7 +987,8 @@ enum Types
 	TypeExtension,
 	TypeExpression,
 	TypeConstantOp,
-	TypeUndef
+	TypeUndef,
+	TypeCount
 };
 
 struct SPIRUndef : IVariant
@@ -267,7 +1089,8 @@ struct SPIRType : IVariant
 	uint32_t type_alias = 0;
 
 	// Used in backends to avoid emitting members with conflicting names.
-	std::unordered_set<std::string> member_name_cache;
+	// Holds StringInterner handles of the member names.
+	std::unordered_set<uint32_t> member_name_cache;
 };
 
 struct SPIRExtension : IVariant
@@ -354,6 +1177,16 @@ struct SPIRExpression : IVariant
 
 	// A list of expressions which this expression depends on.
 	std::vector<uint32_t> expression_dependencies;
+
+	// Whether expression must be enclosed in parentheses to be used as an operand.
+	// The expression string never changes after creation, so this is only worked out on first use.
+	enum Enclose : uint8_t
+	{
+		EncloseUnknown,
+		EncloseNotNeeded,
+		EncloseNeeded
+	};
+	Enclose enclose = EncloseUnknown;
 };
 
 struct SPIRFunctionPrototype : IVariant
@@ -800,32 +1633,128 @@ struct SPIRConstant : IVariant
 	std::vector<uint32_t> subconstants;
 };
 
+// Type-erased interface so a Variant can hand its object back to the right pool.
+class ObjectPoolBase
+{
+public:
+	virtual ~ObjectPoolBase() = default;
+	virtual void free_opaque(IVariant *ptr) = 0;
+	virtual IVariant *clone_opaque(const IVariant *ptr) = 0;
+};
+
+// Allocates objects of one type out of geometrically growing blocks.
+// Freed objects are destroyed and their slots recycled for later allocations,
+// and all memory is released in bulk when the pool is destroyed.
+template <typename T>
+class ObjectPool : public ObjectPoolBase
+{
+public:
+	explicit ObjectPool(uint32_t start_object_count_ = 16)
+	    : start_object_count(start_object_count_)
+	{
+	}
+
+	template <typename... P>
+	T *allocate(P &&... p)
+	{
+		if (vacants.empty())
+		{
+			uint32_t num_objects = start_object_count << memory.size();
+			T *ptr = static_cast<T *>(::operator new(num_objects * sizeof(T), std::nothrow));
+			if (!ptr)
+				SPIRV_CROSS_THROW("Out of memory.");
+
+			for (uint32_t i = 0; i < num_objects; i++)
+				vacants.push_back(&ptr[num_objects - i - 1]);
+			memory.emplace_back(ptr);
+		}
+
+		T *ptr = vacants.back();
+		vacants.pop_back();
+		new (ptr) T(std::forward<P>(p)...);
+		return ptr;
+	}
+
+	void free(T *ptr)
+	{
+		ptr->~T();
+		vacants.push_back(ptr);
+	}
+
+	void free_opaque(IVariant *ptr) override
+	{
+		free(static_cast<T *>(ptr));
+	}
+
+	IVariant *clone_opaque(const IVariant *ptr) override
+	{
+		return allocate(*static_cast<const T *>(ptr));
+	}
+
+private:
+	struct BlockDeleter
+	{
+		void operator()(T *ptr)
+		{
+			::operator delete(ptr);
+		}
+	};
+
+	uint32_t start_object_count;
+	std::vector<T *> vacants;
+	std::vector<std::unique_ptr<T, BlockDeleter>> memory;
+};
+
+// One pool per Types value. Owned by the Compiler and shared by all of its Variants.
+struct ObjectPoolGroup
+{
+	std::unique_ptr<ObjectPoolBase> pools[TypeCount];
+};
+
 class Variant
 {
 public:
-	// MSVC 2013 workaround, we shouldn't need these constructors.
-	Variant() = default;
-	Variant(Variant &&other)
+	explicit Variant(ObjectPoolGroup *group_)
+	    : group(group_)
+	{
+	}
+
+	~Variant()
+	{
+		reset();
+	}
+
+	Variant(Variant &&other) noexcept
 	{
 		*this = std::move(other);
 	}
-	Variant &operator=(Variant &&other)
+
+	Variant &operator=(Variant &&other) noexcept
 	{
 		if (this != &other)
 		{
-			holder = move(other.holder);
+			reset();
+			holder = other.holder;
+			group = other.group;
 			type = other.type;
+			other.holder = nullptr;
 			other.type = TypeNone;
 		}
 		return *this;
 	}
 
-	void set(std::unique_ptr<IVariant> val, uint32_t new_type)
+	template <typename T, typename... P>
+	T &emplace(P &&... args)
 	{
-		holder = std::move(val);
-		if (type != TypeNone && type != new_type)
+		if (type != TypeNone && type != T::type)
 			SPIRV_CROSS_THROW("Overwriting a variant with new type.");
-		type = new_type;
+
+		auto &pool = static_cast<ObjectPool<T> &>(*group->pools[T::type]);
+		T *ptr = pool.allocate(std::forward<P>(args)...);
+		reset();
+		holder = ptr;
+		type = T::type;
+		return *ptr;
 	}
 
 	template <typename T>
@@ -835,7 +1764,7 @@ public:
 			SPIRV_CROSS_THROW("nullptr");
 		if (T::type != type)
 			SPIRV_CROSS_THROW("Bad cast");
-		return *static_cast<T *>(holder.get());
+		return *static_cast<T *>(holder);
 	}
 
 	template <typename T>
@@ -845,7 +1774,7 @@ public:
 			SPIRV_CROSS_THROW("nullptr");
 		if (T::type != type)
 			SPIRV_CROSS_THROW("Bad cast");
-		return *static_cast<const T *>(holder.get());
+		return *static_cast<const T *>(holder);
 	}
 
 	uint32_t get_type() const
@@ -856,14 +1785,30 @@ public:
 	{
 		return !holder;
 	}
+
+	// Deep-copies the object held by other into this variant's own pool.
+	void copy_from(const Variant &other)
+	{
+		reset();
+		if (other.holder)
+		{
+			holder = group->pools[other.type]->clone_opaque(other.holder);
+			type = other.type;
+		}
+	}
+
+	// Returns the object to its pool so the slot can be reused.
 	void reset()
 	{
-		holder.reset();
+		if (holder)
+			group->pools[type]->free_opaque(holder);
+		holder = nullptr;
 		type = TypeNone;
 	}
 
 private:
-	std::unique_ptr<IVariant> holder;
+	ObjectPoolGroup *group = nullptr;
+	IVariant *holder = nullptr;
 	uint32_t type = TypeNone;
 };
 
@@ -882,18 +1827,56 @@ const T &variant_get(const Variant &var)
 template <typename T, typename... P>
 T &variant_set(Variant &var, P &&... args)
 {
-	auto uptr = std::unique_ptr<T>(new T(std::forward<P>(args)...));
-	auto ptr = uptr.get();
-	var.set(std::move(uptr), T::type);
-	return *ptr;
+	return var.emplace<T>(std::forward<P>(args)...);
 }
 
+// Per-module storage for identifier names.
+// Every distinct string is stored once and referred to by a stable handle,
+// so names can be copied and compared as plain integers.
+// Handle 0 is always the empty string.
+class StringInterner
+{
+public:
+	StringInterner()
+	{
+		strings.emplace_back();
+	}
+
+	uint32_t intern(const std::string &str)
+	{
+		if (str.empty())
+			return 0;
+
+		size_t hash = std::hash<std::string>()(str);
+		auto range = lookup.equal_range(hash);
+		for (auto itr = range.first; itr != range.second; ++itr)
+			if (strings[itr->second] == str)
+				return itr->second;
+
+		auto handle = uint32_t(strings.size());
+		strings.push_back(str);
+		lookup.insert({ hash, handle });
+		return handle;
+	}
+
+	// Strings are never moved once interned, so the reference stays valid for the lifetime of the interner.
+	const std::string &get(uint32_t handle) const
+	{
+		return strings[handle];
+	}
+
+private:
+	std::deque<std::string> strings;
+	std::unordered_multimap<size_t, uint32_t> lookup;
+};
+
 struct Meta
 {
 	struct Decoration
 	{
-		std::string alias;
-		std::string qualified_alias;
+		// StringInterner handles.
+		uint32_t alias = 0;
+		uint32_t qualified_alias = 0;
 		uint64_t decoration_flags = 0;
 		spv::BuiltIn builtin_type;
 		uint32_t location = 0;
@@ -916,22 +1899,6 @@ struct Meta
 // name_of_type is the textual name of the type which will be used in the code unless written to by the callback.
 using VariableTypeRemapCallback =
     std::function<void(const SPIRType &type, const std::string &var_name, std::string &name_of_type)>;
-
-class ClassicLocale
-{
-public:
-	ClassicLocale()
-	{
-		old = std::locale::global(std::locale::classic());
-	}
-	~ClassicLocale()
-	{
-		std::locale::global(old);
-	}
-
-private:
-	std::locale old;
-};
 }
 
 #endif
@@ -279,9 +279,6 @@ void CompilerCPP::emit_resources()
 
 string CompilerCPP::compile()
 {
-	// Force a classic "C" locale, reverts when function returns
-	ClassicLocale classic_locale;
-
 	// Do not deal with ES-isms like precision, older extensions and such.
 	options.es = false;
 	options.version = 450;
@@ -297,7 +294,9 @@ string CompilerCPP::compile()
 	backend.explicit_struct_type = true;
 	backend.use_initializer_list = true;
 
-	uint32_t pass_count = 0;
+	analyze_static_access();
+
+	pass_count = 0;
 	do
 	{
 		if (pass_count >= 3)
@@ -306,14 +305,16 @@ string CompilerCPP::compile()
 		resource_registrations.clear();
 		reset();
 
-		// Move constructor for this type is broken on GCC 4.9 ...
-		buffer = unique_ptr<ostringstream>(new ostringstream());
+		buffer.reset();
+		begin_pass_stats();
 
 		emit_header();
 		emit_resources();
 
+		analyze_variable_scopes();
 		emit_function(get<SPIRFunction>(entry_point), 0);
 
+		end_pass_stats();
 		pass_count++;
 	} while (force_recompile);
 
@@ -325,7 +326,17 @@ string CompilerCPP::compile()
 	// Emit C entry points
 	emit_c_linkage();
 
-	return buffer->str();
+	if (stats_enabled)
+		stats.emitted_bytes = buffer.size();
+
+	return buffer.release();
+}
+
+void CompilerCPP::hash_compile_state(Hasher &hasher) const
+{
+	CompilerGLSL::hash_compile_state(hasher);
+	hasher.string("cpp");
+	hasher.string(interface_name);
 }
 
 void CompilerCPP::emit_c_linkage()
@@ -349,12 +360,23 @@ void CompilerCPP::emit_c_linkage()
 	statement("static_cast<", impl_type, "*>(shader)->invoke();");
 	end_scope();
 
+	bool compute = get_entry_point().model == ExecutionModelGLCompute;
+	if (compute)
+	{
+		statement("");
+		statement("void spirv_cross_dispatch(spirv_cross_shader_t *shader, unsigned x, unsigned y, unsigned z)");
+		begin_scope();
+		statement("static_cast<", impl_type, "*>(shader)->dispatch(x, y, z);");
+		end_scope();
+	}
+
 	statement("");
 	statement("static const struct spirv_cross_interface vtable =");
 	begin_scope();
 	statement("spirv_cross_construct,");
 	statement("spirv_cross_destruct,");
 	statement("spirv_cross_invoke,");
+	statement(compute ? "spirv_cross_dispatch," : "nullptr,");
 	end_scope_decl();
 
 	statement("");
@@ -441,6 +463,27 @@ string CompilerCPP::variable_decl(const SPIRType &type, const string &name)
 	return base + name + (runtime ? "[1]" : "");
 }
 
+bool CompilerCPP::uses_control_barrier() const
+{
+	struct BarrierHandler : OpcodeHandler
+	{
+		bool handle(Op opcode, const uint32_t *, uint32_t)
+		{
+			if (opcode == OpControlBarrier)
+			{
+				found = true;
+				return false;
+			}
+			return true;
+		}
+
+		bool found = false;
+	} handler;
+
+	traverse_all_reachable_opcodes(get<SPIRFunction>(entry_point), handler);
+	return handler.found;
+}
+
 void CompilerCPP::emit_header()
 {
 	auto &execution = get_entry_point();
@@ -494,7 +537,8 @@ void CompilerCPP::emit_header()
 
 	case ExecutionModelGLCompute:
 		impl_type = join("ComputeShader<Impl::Shader, Impl::Shader::Resources, ", execution.workgroup_size.x, ", ",
-		                 execution.workgroup_size.y, ", ", execution.workgroup_size.z, ">");
+		                 execution.workgroup_size.y, ", ", execution.workgroup_size.z, ", ",
+		                 uses_control_barrier() ? "true" : "false", ">");
 		resource_type = "ComputeResources";
 		break;
 
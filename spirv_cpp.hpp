@@ -26,8 +26,18 @@ namespace spirv_cross
 class CompilerCPP : public CompilerGLSL
 {
 public:
-	CompilerCPP(std::vector<uint32_t> spirv_)
-	    : CompilerGLSL(move(spirv_))
+	CompilerCPP(std::vector<uint32_t> spirv_, bool time_parse = false)
+	    : CompilerGLSL(move(spirv_), time_parse)
+	{
+	}
+
+	CompilerCPP(ParsedIR ir)
+	    : CompilerGLSL(std::move(ir))
+	{
+	}
+
+	CompilerCPP(const uint32_t *ir, size_t word_count, bool time_parse = false)
+	    : CompilerGLSL(ir, word_count, time_parse)
 	{
 	}
 	std::string compile() override;
@@ -43,8 +53,12 @@ public:
 	}
 
 private:
+	void hash_compile_state(Hasher &hasher) const override;
 	void emit_header() override;
 	void emit_c_linkage();
+
+	// Compute shaders which never wait on a barrier can run their invocations as plain calls.
+	bool uses_control_barrier() const;
 	void emit_function_prototype(SPIRFunction &func, uint64_t return_flags) override;
 
 	void emit_resources();
@@ -27,7 +27,7 @@ using namespace spirv_cross;
 
 #define log(...) fprintf(stderr, __VA_ARGS__)
 
-Instruction::Instruction(const vector<uint32_t> &spirv, uint32_t &index)
+Instruction::Instruction(const uint32_t *spirv, size_t word_count, uint32_t &index)
 {
 	op = spirv[index] & 0xffff;
 	count = (spirv[index] >> 16) & 0xffff;
@@ -40,20 +40,289 @@ Instruction::Instruction(const vector<uint32_t> &spirv, uint32_t &index)
 
 	index += count;
 
-	if (index > spirv.size())
+	if (index > word_count)
 		SPIRV_CROSS_THROW("SPIR-V instruction goes out of bounds.");
 }
 
-Compiler::Compiler(vector<uint32_t> ir)
-    : spirv(move(ir))
+ParsedIR::ParsedIR()
 {
+	pool_group.reset(new ObjectPoolGroup);
+	auto &pools = pool_group->pools;
+	pools[TypeType].reset(new ObjectPool<SPIRType>);
+	pools[TypeVariable].reset(new ObjectPool<SPIRVariable>);
+	pools[TypeConstant].reset(new ObjectPool<SPIRConstant>);
+	pools[TypeFunction].reset(new ObjectPool<SPIRFunction>);
+	pools[TypeFunctionPrototype].reset(new ObjectPool<SPIRFunctionPrototype>);
+	pools[TypeBlock].reset(new ObjectPool<SPIRBlock>);
+	pools[TypeExtension].reset(new ObjectPool<SPIRExtension>);
+	pools[TypeExpression].reset(new ObjectPool<SPIRExpression>);
+	pools[TypeConstantOp].reset(new ObjectPool<SPIRConstantOp>);
+	pools[TypeUndef].reset(new ObjectPool<SPIRUndef>);
+}
+
+ParsedIR::ParsedIR(const ParsedIR &other)
+    : ParsedIR()
+{
+	*this = other;
+}
+
+ParsedIR &ParsedIR::operator=(const ParsedIR &other)
+{
+	if (this == &other)
+		return *this;
+
+	// Caller-owned memory can be shared, but our own copy must point to our own words.
+	spirv = other.spirv;
+	spirv_words = spirv.empty() ? other.spirv_words : spirv.data();
+	spirv_word_count = other.spirv_word_count;
+	inst = other.inst;
+
+	ids.clear();
+	ids.reserve(other.ids.size());
+	for (auto &id : other.ids)
+	{
+		ids.emplace_back(pool_group.get());
+		ids.back().copy_from(id);
+
+		// Parameter links point into the other IR's functions. They are set up again when a function is emitted.
+		if (ids.back().get_type() == TypeVariable)
+			ids.back().get<SPIRVariable>().parameter = nullptr;
+	}
+
+	meta = other.meta;
+	names = other.names;
+	global_variables = other.global_variables;
+	aliased_variables = other.aliased_variables;
+	entry_point = other.entry_point;
+	entry_points = other.entry_points;
+	source = other.source;
+	loop_blocks = other.loop_blocks;
+	continue_blocks = other.continue_blocks;
+	loop_merge_targets = other.loop_merge_targets;
+	selection_merge_targets = other.selection_merge_targets;
+	multiselect_merge_targets = other.multiselect_merge_targets;
+	return *this;
+}
+
+ParsedIR &ParsedIR::operator=(ParsedIR &&other)
+{
+	if (this == &other)
+		return *this;
+
+	// Our IDs have to go back to our own pools before those are replaced.
+	ids.clear();
+
+	spirv = move(other.spirv);
+	spirv_words = other.spirv_words;
+	spirv_word_count = other.spirv_word_count;
+	inst = move(other.inst);
+	pool_group = move(other.pool_group);
+	ids = move(other.ids);
+	meta = move(other.meta);
+	names = move(other.names);
+	global_variables = move(other.global_variables);
+	aliased_variables = move(other.aliased_variables);
+	entry_point = other.entry_point;
+	entry_points = move(other.entry_points);
+	source = other.source;
+	loop_blocks = move(other.loop_blocks);
+	continue_blocks = move(other.continue_blocks);
+	loop_merge_targets = move(other.loop_merge_targets);
+	selection_merge_targets = move(other.selection_merge_targets);
+	multiselect_merge_targets = move(other.multiselect_merge_targets);
+	return *this;
+}
+
+Compiler::Compiler(vector<uint32_t> ir, bool time_parse)
+{
+	spirv = move(ir);
+	spirv_words = spirv.data();
+	spirv_word_count = spirv.size();
+
+	StatsTimer timer(time_parse ? &stats.parse_us : nullptr);
 	parse();
 }
 
+Compiler::Compiler(const uint32_t *ir, size_t word_count, bool time_parse)
+{
+	spirv_words = ir;
+	spirv_word_count = word_count;
+
+	StatsTimer timer(time_parse ? &stats.parse_us : nullptr);
+	parse();
+}
+
+Compiler::Compiler(ParsedIR ir)
+    : ParsedIR(move(ir))
+{
+}
+
+const ParsedIR &Compiler::get_parsed_ir() const
+{
+	return *this;
+}
+
+void Compiler::reset_compile_stats()
+{
+	stats.variable_scope_us = 0.0;
+	stats.cfg_us = 0.0;
+	stats.passes.clear();
+	stats.functions.clear();
+	stats.forced_temporaries = 0;
+	stats.invalidated_expressions = 0;
+	stats.emitted_bytes = 0;
+}
+
+CompilerStats::Function &Compiler::get_function_stats(uint32_t id)
+{
+	// Shaders rarely have more than a handful of functions.
+	for (auto &func : stats.functions)
+		if (func.id == id)
+			return func;
+
+	stats.functions.emplace_back();
+	stats.functions.back().id = id;
+	return stats.functions.back();
+}
+
+static void hash_decoration(Hasher &hasher, const StringInterner &names, const Meta::Decoration &dec)
+{
+	hasher.string(names.get(dec.alias));
+	hasher.string(names.get(dec.qualified_alias));
+	hasher.u64(dec.decoration_flags);
+	hasher.u32(dec.builtin);
+	if (dec.builtin)
+		hasher.u32(dec.builtin_type);
+	hasher.u32(dec.location);
+	hasher.u32(dec.set);
+	hasher.u32(dec.binding);
+	hasher.u32(dec.offset);
+	hasher.u32(dec.array_stride);
+	hasher.u32(dec.input_attachment);
+	hasher.u32(dec.spec_id);
+}
+
+void Compiler::hash_compile_state(Hasher &hasher) const
+{
+	hasher.data(spirv_words, spirv_word_count);
+
+	// Rather than tracking every reflection call, hash the state they are able to modify.
+	hasher.u32(uint32_t(meta.size()));
+	for (auto &m : meta)
+	{
+		hash_decoration(hasher, names, m.decoration);
+		hasher.u32(uint32_t(m.members.size()));
+		for (auto &member : m.members)
+			hash_decoration(hasher, names, member);
+		hasher.u32(m.sampler);
+	}
+
+	hasher.u32(uint32_t(ids.size()));
+	for (auto &id : ids)
+	{
+		hasher.u32(id.get_type());
+		switch (id.get_type())
+		{
+		case TypeType:
+		{
+			// Types are rewritten in place by flatten_interface_block().
+			auto &type = id.get<SPIRType>();
+			hasher.u32(type.basetype);
+			hasher.u32(type.width);
+			hasher.u32(type.vecsize);
+			hasher.u32(type.columns);
+			hasher.u32(type.pointer);
+			hasher.u32(type.storage);
+			hasher.u32(uint32_t(type.array.size()));
+			for (uint32_t i = 0; i < type.array.size(); i++)
+			{
+				hasher.u32(type.array[i]);
+				hasher.u32(type.array_size_literal[i]);
+			}
+			hasher.u32(uint32_t(type.member_types.size()));
+			for (auto member : type.member_types)
+				hasher.u32(member);
+			break;
+		}
+
+		case TypeConstant:
+		{
+			// Specialization constants can be modified through get_constant().
+			auto &c = id.get<SPIRConstant>();
+			bool is_64bit = get<SPIRType>(c.constant_type).width == 64;
+			hasher.u32(c.specialization);
+			hasher.u32(c.m.columns);
+			for (uint32_t col = 0; col < c.m.columns; col++)
+			{
+				hasher.u32(c.m.c[col].vecsize);
+				for (uint32_t row = 0; row < c.m.c[col].vecsize; row++)
+				{
+					if (is_64bit)
+						hasher.u64(c.m.c[col].r[row].u64);
+					else
+						hasher.u32(c.m.c[col].r[row].u32);
+				}
+			}
+			for (auto sub : c.subconstants)
+				hasher.u32(sub);
+			break;
+		}
+
+		case TypeVariable:
+		{
+			auto &var = id.get<SPIRVariable>();
+			hasher.u32(var.remapped_variable);
+			hasher.u32(var.remapped_components);
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	auto &execution = get_entry_point();
+	hasher.u32(entry_point);
+	hasher.string(execution.name);
+	hasher.u64(execution.flags);
+	hasher.u32(execution.workgroup_size.x);
+	hasher.u32(execution.workgroup_size.y);
+	hasher.u32(execution.workgroup_size.z);
+	hasher.u32(execution.invocations);
+	hasher.u32(execution.output_vertices);
+
+	hasher.u32(check_active_interface_variables);
+	if (check_active_interface_variables)
+	{
+		// Iteration is in ascending order, so this does not depend on insertion order.
+		vector<uint32_t> active(begin(active_interface_variables), end(active_interface_variables));
+		hasher.data(active.data(), active.size());
+	}
+
+	hasher.u32(uint32_t(combined_image_samplers.size()));
+	for (auto &combined : combined_image_samplers)
+	{
+		hasher.u32(combined.combined_id);
+		hasher.u32(combined.image_id);
+		hasher.u32(combined.sampler_id);
+	}
+}
+
+bool Compiler::get_compile_hash(HashValue &hash) const
+{
+	// The callback is opaque, so there is no way to tell whether two of them remap the same way.
+	if (variable_remap_callback)
+		return false;
+
+	Hasher hasher;
+	hasher.u32(kCompileHashVersion);
+	hash_compile_state(hasher);
+	hash = hasher.get();
+	return true;
+}
+
 string Compiler::compile()
 {
-	// Force a classic "C" locale, reverts when function returns
-	ClassicLocale classic_locale;
 	return "";
 }
 
@@ -67,7 +336,7 @@ bool Compiler::variable_storage_is_aliased(const SPIRVariable &v)
 	return !is_restrict && (ssbo || image || counter);
 }
 
-bool Compiler::block_is_pure(const SPIRBlock &block)
+bool Compiler::block_is_pure(const SPIRBlock &block, unordered_set<uint32_t> &checked_functions)
 {
 	for (auto &i : block.ops)
 	{
@@ -78,8 +347,9 @@ bool Compiler::block_is_pure(const SPIRBlock &block)
 		{
 		case OpFunctionCall:
 		{
+			// A function we already got through is pure, otherwise we would have returned.
 			uint32_t func = ops[2];
-			if (!function_is_pure(get<SPIRFunction>(func)))
+			if (checked_functions.insert(func).second && !function_is_pure(get<SPIRFunction>(func), checked_functions))
 				return false;
 			break;
 		}
@@ -149,17 +419,23 @@ string Compiler::to_name(uint32_t id, bool allow_alias)
 			return to_name(type.type_alias);
 	}
 
-	if (meta[id].decoration.alias.empty())
+	if (meta[id].decoration.alias == 0)
 		return join("_", id);
 	else
-		return meta.at(id).decoration.alias;
+		return names.get(meta.at(id).decoration.alias);
 }
 
 bool Compiler::function_is_pure(const SPIRFunction &func)
+{
+	unordered_set<uint32_t> checked_functions = { func.self };
+	return function_is_pure(func, checked_functions);
+}
+
+bool Compiler::function_is_pure(const SPIRFunction &func, unordered_set<uint32_t> &checked_functions)
 {
 	for (auto block : func.blocks)
 	{
-		if (!block_is_pure(get<SPIRBlock>(block)))
+		if (!block_is_pure(get<SPIRBlock>(block), checked_functions))
 		{
 			//fprintf(stderr, "Function %s is impure!\n", to_name(func.self).c_str());
 			return false;
@@ -170,7 +446,8 @@ bool Compiler::function_is_pure(const SPIRFunction &func)
 	return true;
 }
 
-void Compiler::register_global_read_dependencies(const SPIRBlock &block, uint32_t id)
+void Compiler::register_global_read_dependencies(const SPIRBlock &block, uint32_t id,
+                                                 unordered_set<uint32_t> &visited_functions)
 {
 	for (auto &i : block.ops)
 	{
@@ -181,8 +458,11 @@ void Compiler::register_global_read_dependencies(const SPIRBlock &block, uint32_
 		{
 		case OpFunctionCall:
 		{
+			// The dependencies of a function do not depend on where it is called from.
 			uint32_t func = ops[2];
-			register_global_read_dependencies(get<SPIRFunction>(func), id);
+			if (visited_functions.insert(func).second)
+				for (auto callee_block : get<SPIRFunction>(func).blocks)
+					register_global_read_dependencies(get<SPIRBlock>(callee_block), id, visited_functions);
 			break;
 		}
 
@@ -210,8 +490,9 @@ void Compiler::register_global_read_dependencies(const SPIRBlock &block, uint32_
 
 void Compiler::register_global_read_dependencies(const SPIRFunction &func, uint32_t id)
 {
+	unordered_set<uint32_t> visited_functions = { func.self };
 	for (auto block : func.blocks)
-		register_global_read_dependencies(get<SPIRBlock>(block), id);
+		register_global_read_dependencies(get<SPIRBlock>(block), id, visited_functions);
 }
 
 SPIRVariable *Compiler::maybe_get_backing_variable(uint32_t chain)
@@ -278,6 +559,8 @@ void Compiler::register_write(uint32_t chain)
 
 void Compiler::flush_dependees(SPIRVariable &var)
 {
+	if (stats_enabled)
+		stats.invalidated_expressions += uint32_t(var.dependees.size());
 	for (auto expr : var.dependees)
 		invalid_expressions.insert(expr);
 	var.dependees.clear();
@@ -400,7 +683,7 @@ bool Compiler::is_hidden_variable(const SPIRVariable &var, bool include_builtins
 
 	bool hidden = false;
 	if (check_active_interface_variables && storage_class_is_interface(var.storage))
-		hidden = active_interface_variables.find(var.self) == end(active_interface_variables);
+		hidden = !active_interface_variables.count(var.self);
 	return hidden;
 }
 
@@ -450,7 +733,7 @@ ShaderResources Compiler::get_shader_resources() const
 	return get_shader_resources(nullptr);
 }
 
-ShaderResources Compiler::get_shader_resources(const unordered_set<uint32_t> &active_variables) const
+ShaderResources Compiler::get_shader_resources(const IDBitset &active_variables) const
 {
 	return get_shader_resources(&active_variables);
 }
@@ -539,22 +822,22 @@ bool Compiler::InterfaceVariableAccessHandler::handle(Op opcode, const uint32_t
 	return true;
 }
 
-unordered_set<uint32_t> Compiler::get_active_interface_variables() const
+IDBitset Compiler::get_active_interface_variables() const
 {
 	// Traverse the call graph and find all interface variables which are in use.
-	unordered_set<uint32_t> variables;
+	IDBitset variables(get_current_id_bound());
 	InterfaceVariableAccessHandler handler(*this, variables);
 	traverse_all_reachable_opcodes(get<SPIRFunction>(entry_point), handler);
 	return variables;
 }
 
-void Compiler::set_enabled_interface_variables(std::unordered_set<uint32_t> active_variables)
+void Compiler::set_enabled_interface_variables(IDBitset active_variables)
 {
 	active_interface_variables = move(active_variables);
 	check_active_interface_variables = true;
 }
 
-ShaderResources Compiler::get_shader_resources(const unordered_set<uint32_t> *active_variables) const
+ShaderResources Compiler::get_shader_resources(const IDBitset *active_variables) const
 {
 	ShaderResources res;
 
@@ -571,75 +854,75 @@ ShaderResources Compiler::get_shader_resources(const unordered_set<uint32_t> *ac
 		if (var.storage == StorageClassFunction || !type.pointer || is_builtin_variable(var))
 			continue;
 
-		if (active_variables && active_variables->find(var.self) == end(*active_variables))
+		if (active_variables && !active_variables->count(var.self))
 			continue;
 
 		// Input
 		if (var.storage == StorageClassInput && interface_variable_exists_in_entry_point(var.self))
 		{
 			if (meta[type.self].decoration.decoration_flags & (1ull << DecorationBlock))
-				res.stage_inputs.push_back({ var.self, var.basetype, type.self, meta[type.self].decoration.alias });
+				res.stage_inputs.push_back({ var.self, var.basetype, type.self, get_name(type.self) });
 			else
-				res.stage_inputs.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+				res.stage_inputs.push_back({ var.self, var.basetype, type.self, get_name(var.self) });
 		}
 		// Subpass inputs
 		else if (var.storage == StorageClassUniformConstant && type.image.dim == DimSubpassData)
 		{
-			res.subpass_inputs.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.subpass_inputs.push_back({ var.self, var.basetype, type.self, get_name(var.self) });
 		}
 		// Outputs
 		else if (var.storage == StorageClassOutput && interface_variable_exists_in_entry_point(var.self))
 		{
 			if (meta[type.self].decoration.decoration_flags & (1ull << DecorationBlock))
-				res.stage_outputs.push_back({ var.self, var.basetype, type.self, meta[type.self].decoration.alias });
+				res.stage_outputs.push_back({ var.self, var.basetype, type.self, get_name(type.self) });
 			else
-				res.stage_outputs.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+				res.stage_outputs.push_back({ var.self, var.basetype, type.self, get_name(var.self) });
 		}
 		// UBOs
 		else if (type.storage == StorageClassUniform &&
 		         (meta[type.self].decoration.decoration_flags & (1ull << DecorationBlock)))
 		{
-			res.uniform_buffers.push_back({ var.self, var.basetype, type.self, meta[type.self].decoration.alias });
+			res.uniform_buffers.push_back({ var.self, var.basetype, type.self, get_name(type.self) });
 		}
 		// SSBOs
 		else if (type.storage == StorageClassUniform &&
 		         (meta[type.self].decoration.decoration_flags & (1ull << DecorationBufferBlock)))
 		{
-			res.storage_buffers.push_back({ var.self, var.basetype, type.self, meta[type.self].decoration.alias });
+			res.storage_buffers.push_back({ var.self, var.basetype, type.self, get_name(type.self) });
 		}
 		// Push constant blocks
 		else if (type.storage == StorageClassPushConstant)
 		{
 			// There can only be one push constant block, but keep the vector in case this restriction is lifted
 			// in the future.
-			res.push_constant_buffers.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.push_constant_buffers.push_back({ var.self, var.basetype, type.self, get_name(var.self) });
 		}
 		// Images
 		else if (type.storage == StorageClassUniformConstant && type.basetype == SPIRType::Image &&
 		         type.image.sampled == 2)
 		{
-			res.storage_images.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.storage_images.push_back({ var.self, var.basetype, type.self, get_name(var.self) });
 		}
 		// Separate images
 		else if (type.storage == StorageClassUniformConstant && type.basetype == SPIRType::Image &&
 		         type.image.sampled == 1)
 		{
-			res.separate_images.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.separate_images.push_back({ var.self, var.basetype, type.self, get_name(var.self) });
 		}
 		// Separate samplers
 		else if (type.storage == StorageClassUniformConstant && type.basetype == SPIRType::Sampler)
 		{
-			res.separate_samplers.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.separate_samplers.push_back({ var.self, var.basetype, type.self, get_name(var.self) });
 		}
 		// Textures
 		else if (type.storage == StorageClassUniformConstant && type.basetype == SPIRType::SampledImage)
 		{
-			res.sampled_images.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.sampled_images.push_back({ var.self, var.basetype, type.self, get_name(var.self) });
 		}
 		// Atomic counters
 		else if (type.storage == StorageClassAtomicCounter)
 		{
-			res.atomic_counters.push_back({ var.self, var.basetype, type.self, meta[var.self].decoration.alias });
+			res.atomic_counters.push_back({ var.self, var.basetype, type.self, get_name(var.self) });
 		}
 	}
 
@@ -651,19 +934,23 @@ static inline uint32_t swap_endian(uint32_t v)
 	return ((v >> 24) & 0x000000ffu) | ((v >> 8) & 0x0000ff00u) | ((v << 8) & 0x00ff0000u) | ((v << 24) & 0xff000000u);
 }
 
-static string extract_string(const vector<uint32_t> &spirv, uint32_t offset)
+static string extract_string(const uint32_t *spirv, size_t word_count, uint32_t offset)
 {
-	string ret;
-	for (uint32_t i = offset; i < spirv.size(); i++)
+	// Find the terminator first, so the string is built in one go rather than a character at a time.
+	size_t length = 0;
+	for (uint32_t i = offset; i < word_count; i++)
 	{
 		uint32_t w = spirv[i];
 
-		for (uint32_t j = 0; j < 4; j++, w >>= 8)
+		for (uint32_t j = 0; j < 4; j++, w >>= 8, length++)
 		{
-			char c = w & 0xff;
-			if (c == '\0')
+			if ((w & 0xff) == 0)
+			{
+				string ret(length, '\0');
+				for (size_t k = 0; k < length; k++)
+					ret[k] = char((spirv[offset + k / 4] >> (8 * (k % 4))) & 0xff);
 				return ret;
-			ret += c;
+			}
 		}
 	}
 
@@ -687,26 +974,34 @@ static bool is_valid_spirv_version(uint32_t version)
 
 void Compiler::parse()
 {
-	auto len = spirv.size();
+	auto len = spirv_word_count;
 	if (len < 5)
 		SPIRV_CROSS_THROW("SPIRV file too small.");
 
-	auto s = spirv.data();
-
 	// Endian-swap if we need to.
-	if (s[0] == swap_endian(MagicNumber))
+	// Caller-owned memory is never written to, so only then do we take a private copy.
+	if (spirv_words[0] == swap_endian(MagicNumber))
+	{
+		if (spirv.empty())
+			spirv.assign(spirv_words, spirv_words + spirv_word_count);
 		transform(begin(spirv), end(spirv), begin(spirv), [](uint32_t c) { return swap_endian(c); });
+		spirv_words = spirv.data();
+	}
+
+	auto s = spirv_words;
 
 	if (s[0] != MagicNumber || !is_valid_spirv_version(s[1]))
 		SPIRV_CROSS_THROW("Invalid SPIRV format.");
 
 	uint32_t bound = s[3];
-	ids.resize(bound);
+	ids.reserve(bound);
+	for (uint32_t i = 0; i < bound; i++)
+		ids.emplace_back(pool_group.get());
 	meta.resize(bound);
 
 	uint32_t offset = 5;
 	while (offset < len)
-		inst.emplace_back(spirv, offset);
+		inst.emplace_back(spirv_words, spirv_word_count, offset);
 
 	for (auto &i : inst)
 		parse(i);
@@ -760,34 +1055,30 @@ void Compiler::flatten_interface_block(uint32_t id)
 	var.storage = storage;
 }
 
-void Compiler::update_name_cache(unordered_set<string> &cache, string &name)
+void Compiler::update_name_cache(unordered_set<uint32_t> &cache, uint32_t &name)
 {
-	if (name.empty())
+	if (name == 0)
 		return;
 
-	if (cache.find(name) == end(cache))
-	{
-		cache.insert(name);
+	if (cache.insert(name).second)
 		return;
-	}
 
 	uint32_t counter = 0;
-	auto tmpname = name;
+	auto &tmpname = names.get(name);
 
 	// If there is a collision (very rare),
 	// keep tacking on extra identifier until it's unique.
 	do
 	{
 		counter++;
-		name = tmpname + "_" + convert_to_string(counter);
-	} while (cache.find(name) != end(cache));
-	cache.insert(name);
+		name = names.intern(tmpname + "_" + convert_to_string(counter));
+	} while (!cache.insert(name).second);
 }
 
 void Compiler::set_name(uint32_t id, const std::string &name)
 {
-	auto &str = meta.at(id).decoration.alias;
-	str.clear();
+	auto &alias = meta.at(id).decoration.alias;
+	alias = 0;
 
 	if (name.empty())
 		return;
@@ -797,7 +1088,7 @@ void Compiler::set_name(uint32_t id, const std::string &name)
 
 	// Functions in glslangValidator are mangled with name(<mangled> stuff.
 	// Normally, we would never see '(' in any legal identifiers, so just strip them out.
-	str = name.substr(0, name.find('('));
+	auto str = name.substr(0, name.find('('));
 
 	for (uint32_t i = 0; i < str.size(); i++)
 	{
@@ -810,6 +1101,8 @@ void Compiler::set_name(uint32_t id, const std::string &name)
 		else
 			c = isalnum(c) ? c : '_';
 	}
+
+	alias = names.intern(str);
 }
 
 const SPIRType &Compiler::get_type(uint32_t id) const
@@ -855,25 +1148,22 @@ void Compiler::set_member_decoration(uint32_t id, uint32_t index, Decoration dec
 void Compiler::set_member_name(uint32_t id, uint32_t index, const std::string &name)
 {
 	meta.at(id).members.resize(max(meta[id].members.size(), size_t(index) + 1));
-	meta.at(id).members[index].alias = name;
+	meta.at(id).members[index].alias = names.intern(name);
 }
 
 const std::string &Compiler::get_member_name(uint32_t id, uint32_t index) const
 {
 	auto &m = meta.at(id);
 	if (index >= m.members.size())
-	{
-		static string empty;
-		return empty;
-	}
+		return names.get(0);
 
-	return m.members[index].alias;
+	return names.get(m.members[index].alias);
 }
 
 void Compiler::set_member_qualified_name(uint32_t id, uint32_t index, const std::string &name)
 {
 	meta.at(id).members.resize(max(meta[id].members.size(), size_t(index) + 1));
-	meta.at(id).members[index].qualified_alias = name;
+	meta.at(id).members[index].qualified_alias = names.intern(name);
 }
 
 uint32_t Compiler::get_member_decoration(uint32_t id, uint32_t index, Decoration decoration) const
@@ -994,7 +1284,7 @@ StorageClass Compiler::get_storage_class(uint32_t id) const
 
 const std::string &Compiler::get_name(uint32_t id) const
 {
-	return meta.at(id).decoration.alias;
+	return names.get(meta.at(id).decoration.alias);
 }
 
 uint64_t Compiler::get_decoration_mask(uint32_t id) const
@@ -1132,7 +1422,7 @@ void Compiler::parse(const Instruction &instruction)
 	case OpExtInstImport:
 	{
 		uint32_t id = ops[0];
-		auto ext = extract_string(spirv, instruction.offset + 1);
+		auto ext = extract_string(spirv_words, spirv_word_count, instruction.offset + 1);
 		if (ext == "GLSL.std.450")
 			set<SPIRExtension>(id, SPIRExtension::GLSL);
 		else
@@ -1145,7 +1435,7 @@ void Compiler::parse(const Instruction &instruction)
 	{
 		auto itr =
 		    entry_points.insert(make_pair(ops[1], SPIREntryPoint(ops[1], static_cast<ExecutionModel>(ops[0]),
-		                                                         extract_string(spirv, instruction.offset + 2))));
+		                                                         extract_string(spirv_words, spirv_word_count, instruction.offset + 2))));
 		auto &e = itr.first->second;
 
 		// Strings need nul-terminator and consume the whole word.
@@ -1192,7 +1482,7 @@ void Compiler::parse(const Instruction &instruction)
 	case OpName:
 	{
 		uint32_t id = ops[0];
-		set_name(id, extract_string(spirv, instruction.offset + 1));
+		set_name(id, extract_string(spirv_words, spirv_word_count, instruction.offset + 1));
 		break;
 	}
 
@@ -1200,7 +1490,7 @@ void Compiler::parse(const Instruction &instruction)
 	{
 		uint32_t id = ops[0];
 		uint32_t member = ops[1];
-		set_member_name(id, member, extract_string(spirv, instruction.offset + 2));
+		set_member_name(id, member, extract_string(spirv_words, spirv_word_count, instruction.offset + 2));
 		break;
 	}
 
@@ -1997,7 +2287,8 @@ SPIRBlock::ContinueBlockType Compiler::continue_block_type(const SPIRBlock &bloc
 	}
 }
 
-bool Compiler::traverse_all_reachable_opcodes(const SPIRBlock &block, OpcodeHandler &handler) const
+bool Compiler::traverse_all_reachable_opcodes(const SPIRBlock &block, OpcodeHandler &handler,
+                                              unordered_set<uint32_t> &traversed_functions) const
 {
 	handler.set_current_block(block);
 
@@ -2019,8 +2310,16 @@ bool Compiler::traverse_all_reachable_opcodes(const SPIRBlock &block, OpcodeHand
 			{
 				if (!handler.begin_function_scope(ops, i.length))
 					return false;
-				if (!traverse_all_reachable_opcodes(get<SPIRFunction>(ops[2]), handler))
+
+				// Walking the callee again at every call site is exponential in the depth of diamond-shaped call graphs.
+				if (traversed_functions.insert(func.self).second)
+				{
+					if (!traverse_all_reachable_opcodes(func, handler, traversed_functions))
+						return false;
+				}
+				else if (!handler.handle_repeated_call(func))
 					return false;
+
 				if (!handler.end_function_scope(ops, i.length))
 					return false;
 			}
@@ -2030,15 +2329,22 @@ bool Compiler::traverse_all_reachable_opcodes(const SPIRBlock &block, OpcodeHand
 	return true;
 }
 
-bool Compiler::traverse_all_reachable_opcodes(const SPIRFunction &func, OpcodeHandler &handler) const
+bool Compiler::traverse_all_reachable_opcodes(const SPIRFunction &func, OpcodeHandler &handler,
+                                              unordered_set<uint32_t> &traversed_functions) const
 {
 	for (auto block : func.blocks)
-		if (!traverse_all_reachable_opcodes(get<SPIRBlock>(block), handler))
+		if (!traverse_all_reachable_opcodes(get<SPIRBlock>(block), handler, traversed_functions))
 			return false;
 
 	return true;
 }
 
+bool Compiler::traverse_all_reachable_opcodes(const SPIRFunction &func, OpcodeHandler &handler) const
+{
+	unordered_set<uint32_t> traversed_functions = { func.self };
+	return traverse_all_reachable_opcodes(func, handler, traversed_functions);
+}
+
 uint32_t Compiler::type_struct_member_offset(const SPIRType &type, uint32_t index) const
 {
 	// Decoration must be set in valid SPIR-V, otherwise throw.
@@ -2191,7 +2497,8 @@ uint32_t Compiler::increase_bound_by(uint32_t incr_amount)
 {
 	auto curr_bound = ids.size();
 	auto new_bound = curr_bound + incr_amount;
-	ids.resize(new_bound);
+	for (uint32_t i = 0; i < incr_amount; i++)
+		ids.emplace_back(pool_group.get());
 	meta.resize(new_bound);
 	return uint32_t(curr_bound);
 }
@@ -2483,6 +2790,30 @@ bool Compiler::CombinedImageSamplerHandler::end_function_scope(const uint32_t *a
 		return true;
 
 	auto &caller = *functions.top();
+
+	// Fold what the callee samples into the caller's summary, rewriting callee parameters to our arguments.
+	auto itr = function_sampled_images.find(callee.self);
+	if (itr != end(function_sampled_images))
+	{
+		auto to_caller = [&](uint32_t id) -> uint32_t {
+			for (uint32_t i = 0; i < length && i < callee.arguments.size(); i++)
+			{
+				if (callee.arguments[i].id == id)
+				{
+					auto *var = compiler.maybe_get_backing_variable(args[i]);
+					return var ? var->self : args[i];
+				}
+			}
+			return id;
+		};
+
+		// Copy, the caller's entry might be inserted into the same map.
+		auto sampled_images = itr->second;
+		for (auto &sampled : sampled_images)
+			add_function_sampled_image(caller.self,
+			                           { sampled.sampled_type, to_caller(sampled.image_id), to_caller(sampled.sampler_id) });
+	}
+
 	if (caller.do_combined_parameters)
 	{
 		for (auto &param : params)
@@ -2662,13 +2993,48 @@ bool Compiler::CombinedImageSamplerHandler::handle(Op opcode, const uint32_t *ar
 		}
 	}
 
+	// Remember what we sample in terms of our own scope, so later calls to this function need not walk it again.
+	if (!functions.empty())
+	{
+		auto *image = compiler.maybe_get_backing_variable(args[2]);
+		auto *sampler = compiler.maybe_get_backing_variable(args[3]);
+		add_function_sampled_image(functions.top()->self,
+		                           { args[0], image ? image->self : args[2], sampler ? sampler->self : args[3] });
+	}
+
 	// For function calls, we need to remap IDs which are function parameters into global variables.
 	// This information is statically known from the current place in the call stack.
 	// Function parameters are not necessarily pointers, so if we don't have a backing variable, remapping will know
 	// which backing variable the image/sample came from.
-	uint32_t image_id = remap_parameter(args[2]);
-	uint32_t sampler_id = remap_parameter(args[3]);
+	register_global_combined_image_sampler(args[0], remap_parameter(args[2]), remap_parameter(args[3]));
+	return true;
+}
+
+bool Compiler::CombinedImageSamplerHandler::handle_repeated_call(const SPIRFunction &func)
+{
+	// Our parameter remapping is already pushed, so this resolves to the globals of this particular call.
+	auto itr = function_sampled_images.find(func.self);
+	if (itr != end(function_sampled_images))
+		for (auto &sampled : itr->second)
+			register_global_combined_image_sampler(sampled.sampled_type, remap_parameter(sampled.image_id),
+			                                       remap_parameter(sampled.sampler_id));
+	return true;
+}
 
+void Compiler::CombinedImageSamplerHandler::add_function_sampled_image(uint32_t func, const SampledImage &sampled)
+{
+	auto &sampled_images = function_sampled_images[func];
+	auto itr = find_if(begin(sampled_images), end(sampled_images), [&sampled](const SampledImage &s) {
+		return s.image_id == sampled.image_id && s.sampler_id == sampled.sampler_id;
+	});
+	if (itr == end(sampled_images))
+		sampled_images.push_back(sampled);
+}
+
+void Compiler::CombinedImageSamplerHandler::register_global_combined_image_sampler(uint32_t sampled_type,
+                                                                                   uint32_t image_id,
+                                                                                   uint32_t sampler_id)
+{
 	auto itr = find_if(begin(compiler.combined_image_samplers), end(compiler.combined_image_samplers),
 	                   [image_id, sampler_id](const CombinedImageSampler &combined) {
 		                   return combined.image_id == image_id && combined.sampler_id == sampler_id;
@@ -2679,7 +3045,6 @@ bool Compiler::CombinedImageSamplerHandler::handle(Op opcode, const uint32_t *ar
 		auto id = compiler.increase_bound_by(2);
 		auto type_id = id + 0;
 		auto combined_id = id + 1;
-		auto sampled_type = args[0];
 
 		// Make a new type, pointer to OpTypeSampledImage, so we can make a variable of this type.
 		// We will probably have this type lying around, but it doesn't hurt to make duplicates for internal purposes.
@@ -2699,12 +3064,12 @@ bool Compiler::CombinedImageSamplerHandler::handle(Op opcode, const uint32_t *ar
 
 		compiler.combined_image_samplers.push_back({ combined_id, image_id, sampler_id });
 	}
-
-	return true;
 }
 
 void Compiler::build_combined_image_samplers()
 {
+	StatsTimer timer(stats_enabled ? &stats.combined_image_samplers_us : nullptr);
+
 	for (auto &id : ids)
 	{
 		if (id.get_type() == TypeFunction)
@@ -2750,6 +3115,13 @@ const SPIRConstant &Compiler::get_constant(uint32_t id) const
 
 void Compiler::analyze_variable_scope(SPIRFunction &entry)
 {
+	analyze_variable_scope(entry, stats_enabled ? &stats : nullptr);
+}
+
+void Compiler::analyze_variable_scope(SPIRFunction &entry, CompilerStats *timing)
+{
+	StatsTimer timer(timing ? &timing->variable_scope_us : nullptr);
+
 	struct AccessHandler : OpcodeHandler
 	{
 	public:
@@ -2915,7 +3287,9 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry)
 	this->traverse_all_reachable_opcodes(entry, handler);
 
 	// Compute the control flow graph for this function.
+	StatsTimer cfg_timer(timing ? &timing->cfg_us : nullptr);
 	CFG cfg(*this, entry);
+	cfg_timer.stop();
 
 	unordered_map<uint32_t, uint32_t> potential_loop_variables;
 
@@ -2999,14 +3373,14 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry)
 		bool static_loop_init = true;
 		while (dominator != header)
 		{
-			auto &succ = cfg.get_succeeding_edges(dominator);
+			auto succ = cfg.get_succeeding_edges(dominator);
 			if (succ.size() != 1)
 			{
 				static_loop_init = false;
 				break;
 			}
 
-			auto &pred = cfg.get_preceding_edges(succ.front());
+			auto pred = cfg.get_preceding_edges(succ.front());
 			if (pred.size() != 1 || pred.front() != dominator)
 			{
 				static_loop_init = false;
@@ -3031,6 +3405,12 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry)
 		if (!static_loop_init)
 			continue;
 
+		// Loop variables are initialized in a for loop header, so if this loop can never be emitted as one,
+		// reject the variable now rather than letting emission find out and force another pass.
+		if (!block_is_loop_candidate(header_block, SPIRBlock::MergeToSelectForLoop) &&
+		    !block_is_loop_candidate(header_block, SPIRBlock::MergeToDirectForLoop))
+			continue;
+
 		// We have a loop variable.
 		header_block.loop_variables.push_back(loop_variable.first);
 		// Need to sort here as variables come from an unordered container, and pushing stuff in wrong order
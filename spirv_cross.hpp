@@ -18,6 +18,7 @@
 #define SPIRV_CROSS_HPP
 
 #include "spirv.hpp"
+#include <chrono>
 #include <memory>
 #include <stack>
 #include <stdexcept>
@@ -106,14 +107,116 @@ struct BufferRange
 	size_t range;
 };
 
-class Compiler
+// Timings and counters collected while compiling. Only filled in if enabled with Compiler::set_stats_enabled().
+// All times are in microseconds.
+struct CompilerStats
+{
+	struct Pass
+	{
+		double emit_us = 0.0;
+		uint64_t emitted_bytes = 0;
+		// True if this pass found it had to be redone.
+		bool forced_recompile = false;
+	};
+
+	struct Function
+	{
+		uint32_t id = 0;
+		// Time spent emitting the function body, summed over all passes.
+		// Callees are not included, but analyze_variable_scope of the function is,
+		// unless it was done up front on several threads.
+		double emit_us = 0.0;
+	};
+
+	// A module is parsed before stats can be enabled, so parse_us is only recorded if requested
+	// when constructing the compiler. It is zero for compilers constructed from a ParsedIR.
+	double parse_us = 0.0;
+	double combined_image_samplers_us = 0.0;
+	// Total time in analyze_variable_scope, including CFG construction.
+	// Summed over all threads if functions were analyzed on several threads.
+	double variable_scope_us = 0.0;
+	double cfg_us = 0.0;
+
+	std::vector<Pass> passes;
+	std::vector<Function> functions;
+
+	// Expressions which had to be emitted as temporaries, and expressions invalidated by stores.
+	uint32_t forced_temporaries = 0;
+	uint32_t invalidated_expressions = 0;
+
+	// Size of the source returned by compile().
+	uint64_t emitted_bytes = 0;
+};
+
+// Everything the parser extracts from a SPIR-V module: the ID table, names and decorations,
+// entry points and the structured control flow bookkeeping.
+// Copying a ParsedIR deep-copies every ID into its own object pools, so one parsed module
+// can seed any number of backends without being parsed again.
+struct ParsedIR
+{
+	ParsedIR();
+	ParsedIR(const ParsedIR &other);
+	ParsedIR &operator=(const ParsedIR &other);
+	ParsedIR(ParsedIR &&other) = default;
+	ParsedIR &operator=(ParsedIR &&other);
+
+	// Owned copy of the module, if any. spirv_words points either here or into caller-owned memory.
+	std::vector<uint32_t> spirv;
+	const uint32_t *spirv_words = nullptr;
+	size_t spirv_word_count = 0;
+
+	std::vector<Instruction> inst;
+
+	// Backing storage for everything in ids. Must outlive ids, so keep it declared first.
+	std::unique_ptr<ObjectPoolGroup> pool_group;
+	std::vector<Variant> ids;
+	std::vector<Meta> meta;
+	// Backs the names held in meta.
+	StringInterner names;
+
+	std::vector<uint32_t> global_variables;
+	std::vector<uint32_t> aliased_variables;
+
+	uint32_t entry_point = 0;
+	// Normally, we'd stick SPIREntryPoint in ids array, but it conflicts with SPIRFunction.
+	// Entry points can therefore be seen as some sort of meta structure.
+	std::unordered_map<uint32_t, SPIREntryPoint> entry_points;
+
+	struct Source
+	{
+		uint32_t version = 0;
+		bool es = false;
+		bool known = false;
+
+		Source() = default;
+	} source;
+
+	IDBitset loop_blocks;
+	IDBitset continue_blocks;
+	IDBitset loop_merge_targets;
+	IDBitset selection_merge_targets;
+	IDBitset multiselect_merge_targets;
+};
+
+class Compiler : protected ParsedIR
 {
 public:
 	friend class CFG;
 	friend class DominatorBuilder;
 
 	// The constructor takes a buffer of SPIR-V words and parses it.
-	Compiler(std::vector<uint32_t> ir);
+	// If time_parse is true, the time spent parsing is recorded in CompilerStats::parse_us.
+	Compiler(std::vector<uint32_t> ir, bool time_parse = false);
+
+	// Parses SPIR-V directly out of caller-owned memory, e.g. a read-only memory mapping.
+	// The words are only copied if the module needs an endian swap.
+	// Otherwise, the memory must stay valid for the lifetime of the compiler.
+	Compiler(const uint32_t *ir, size_t word_count, bool time_parse = false);
+
+	// Constructs a compiler from an already parsed module, skipping parsing entirely.
+	// Pass a copy to share one parse between several backends, e.g.
+	// CompilerGLSL glsl(parser.get_parsed_ir()); CompilerMSL msl(parser.get_parsed_ir());
+	Compiler(ParsedIR ir);
 
 	virtual ~Compiler() = default;
 
@@ -122,6 +225,28 @@ public:
 	// Sub-classes actually implement this.
 	virtual std::string compile();
 
+	// Returns the parsed module, including any names and decorations set through reflection.
+	// Combined image samplers and interface variable filtering are per-compiler state and are not part of it.
+	const ParsedIR &get_parsed_ir() const;
+
+	// Computes a hash of everything compile() depends on: the SPIR-V module, all reflection changes made
+	// since parsing (decorations, names, remapping, combined image samplers, ...) and the backend options.
+	// Two compilers with the same hash produce the same output, so it can be used as a cache key.
+	// Returns false if the output cannot be cached, e.g. when a variable type remap callback is set.
+	bool get_compile_hash(HashValue &hash) const;
+
+	// Enables collection of CompilerStats for later calls to build_combined_image_samplers() and compile().
+	// When disabled, which is the default, instrumented code only tests a flag.
+	void set_stats_enabled(bool enable)
+	{
+		stats_enabled = enable;
+	}
+
+	const CompilerStats &get_stats() const
+	{
+		return stats;
+	}
+
 	// Gets the identifier (OpName) of an ID. If not defined, an empty string will be returned.
 	const std::string &get_name(uint32_t id) const;
 
@@ -220,12 +345,12 @@ public:
 	//
 	// To use the returned set as the filter for which variables are used during compilation,
 	// this set can be moved to set_enabled_interface_variables().
-	std::unordered_set<uint32_t> get_active_interface_variables() const;
+	IDBitset get_active_interface_variables() const;
 
 	// Sets the interface variables which are used during compilation.
 	// By default, all variables are used.
 	// Once set, compile() will only consider the set in active_variables.
-	void set_enabled_interface_variables(std::unordered_set<uint32_t> active_variables);
+	void set_enabled_interface_variables(IDBitset active_variables);
 
 	// Query shader resources, use ids with reflection interface to modify or query binding points, etc.
 	ShaderResources get_shader_resources() const;
@@ -233,7 +358,7 @@ public:
 	// Query shader resources, but only return the variables which are part of active_variables.
 	// E.g.: get_shader_resources(get_active_variables()) to only return the variables which are statically
 	// accessed.
-	ShaderResources get_shader_resources(const std::unordered_set<uint32_t> &active_variables) const;
+	ShaderResources get_shader_resources(const IDBitset &active_variables) const;
 
 	// Remapped variables are considered built-in variables and a backend will
 	// not emit a declaration for this variable.
@@ -324,6 +449,47 @@ public:
 	}
 
 protected:
+	// Backends extend this with their options and any other state which affects compile().
+	virtual void hash_compile_state(Hasher &hasher) const;
+
+	// Adds the time from construction until stop() or destruction to *target.
+	// A null target makes it a no-op, so pass stats_enabled ? &stats.x : nullptr.
+	class StatsTimer
+	{
+	public:
+		explicit StatsTimer(double *target_)
+		    : target(target_)
+		{
+			if (target)
+				start = std::chrono::steady_clock::now();
+		}
+
+		~StatsTimer()
+		{
+			stop();
+		}
+
+		void stop()
+		{
+			if (target)
+			{
+				*target += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+				target = nullptr;
+			}
+		}
+
+	private:
+		double *target;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	bool stats_enabled = false;
+	CompilerStats stats;
+
+	// Clears everything compile() fills in, keeping parse and combined image sampler timings.
+	void reset_compile_stats();
+	CompilerStats::Function &get_function_stats(uint32_t id);
+
 	const uint32_t *stream(const Instruction &instr) const
 	{
 		// If we're not going to use any arguments, just return nullptr.
@@ -332,21 +498,14 @@ protected:
 		if (!instr.length)
 			return nullptr;
 
-		if (instr.offset + instr.length > spirv.size())
+		if (instr.offset + instr.length > spirv_word_count)
 			SPIRV_CROSS_THROW("Compiler::stream() out of range.");
-		return &spirv[instr.offset];
+		return &spirv_words[instr.offset];
 	}
-	std::vector<uint32_t> spirv;
-
-	std::vector<Instruction> inst;
-	std::vector<Variant> ids;
-	std::vector<Meta> meta;
 
 	SPIRFunction *current_function = nullptr;
 	SPIRBlock *current_block = nullptr;
-	std::vector<uint32_t> global_variables;
-	std::vector<uint32_t> aliased_variables;
-	std::unordered_set<uint32_t> active_interface_variables;
+	IDBitset active_interface_variables;
 	bool check_active_interface_variables = false;
 
 	// If our IDs are out of range here as part of opcodes, throw instead of
@@ -389,28 +548,9 @@ protected:
 			return nullptr;
 	}
 
-	uint32_t entry_point = 0;
-	// Normally, we'd stick SPIREntryPoint in ids array, but it conflicts with SPIRFunction.
-	// Entry points can therefore be seen as some sort of meta structure.
-	std::unordered_map<uint32_t, SPIREntryPoint> entry_points;
 	const SPIREntryPoint &get_entry_point() const;
 	SPIREntryPoint &get_entry_point();
 
-	struct Source
-	{
-		uint32_t version = 0;
-		bool es = false;
-		bool known = false;
-
-		Source() = default;
-	} source;
-
-	std::unordered_set<uint32_t> loop_blocks;
-	std::unordered_set<uint32_t> continue_blocks;
-	std::unordered_set<uint32_t> loop_merge_targets;
-	std::unordered_set<uint32_t> selection_merge_targets;
-	std::unordered_set<uint32_t> multiselect_merge_targets;
-
 	virtual std::string to_name(uint32_t id, bool allow_alias = true);
 	bool is_builtin_variable(const SPIRVariable &var) const;
 	bool is_hidden_variable(const SPIRVariable &var, bool include_builtins = false) const;
@@ -429,19 +569,17 @@ protected:
 
 	inline bool is_continue(uint32_t next) const
 	{
-		return continue_blocks.find(next) != end(continue_blocks);
+		return continue_blocks.count(next);
 	}
 
 	inline bool is_break(uint32_t next) const
 	{
-		return loop_merge_targets.find(next) != end(loop_merge_targets) ||
-		       multiselect_merge_targets.find(next) != end(multiselect_merge_targets);
+		return loop_merge_targets.count(next) || multiselect_merge_targets.count(next);
 	}
 
 	inline bool is_conditional(uint32_t next) const
 	{
-		return selection_merge_targets.find(next) != end(selection_merge_targets) &&
-		       multiselect_merge_targets.find(next) == end(multiselect_merge_targets);
+		return selection_merge_targets.count(next) && !multiselect_merge_targets.count(next);
 	}
 
 	// Dependency tracking for temporaries read from variables.
@@ -449,14 +587,17 @@ protected:
 	void flush_all_active_variables();
 	void flush_all_atomic_capable_variables();
 	void flush_all_aliased_variables();
-	void register_global_read_dependencies(const SPIRBlock &func, uint32_t id);
 	void register_global_read_dependencies(const SPIRFunction &func, uint32_t id);
-	std::unordered_set<uint32_t> invalid_expressions;
+	void register_global_read_dependencies(const SPIRBlock &block, uint32_t id,
+	                                       std::unordered_set<uint32_t> &visited_functions);
+	IDBitset invalid_expressions;
 
-	void update_name_cache(std::unordered_set<std::string> &cache, std::string &name);
+	void update_name_cache(std::unordered_set<uint32_t> &cache, uint32_t &name);
 
+	// Functions reached through several call sites are only checked once.
 	bool function_is_pure(const SPIRFunction &func);
-	bool block_is_pure(const SPIRBlock &block);
+	bool function_is_pure(const SPIRFunction &func, std::unordered_set<uint32_t> &checked_functions);
+	bool block_is_pure(const SPIRBlock &block, std::unordered_set<uint32_t> &checked_functions);
 	bool block_is_outside_flow_control_from_block(const SPIRBlock &from, const SPIRBlock &to);
 
 	bool execution_is_branchless(const SPIRBlock &from, const SPIRBlock &to) const;
@@ -489,6 +630,10 @@ protected:
 
 	void analyze_variable_scope(SPIRFunction &function);
 
+	// Adds timings to timing instead of the compiler's stats, so functions can be analyzed on several threads
+	// at once. Functions do not share any of the state written here. Pass nullptr to skip timing.
+	void analyze_variable_scope(SPIRFunction &function, CompilerStats *timing);
+
 protected:
 	void parse();
 	void parse(const Instruction &i);
@@ -520,6 +665,15 @@ protected:
 		{
 			return true;
 		}
+
+		// A traversal only walks each function once. Later calls to the same function still get
+		// begin_function_scope() and end_function_scope(), but this is called in place of the function body.
+		// Handlers which only collect facts independent of the call site have nothing to do here,
+		// handlers which depend on the call site replay whatever they summarized on the first visit.
+		virtual bool handle_repeated_call(const SPIRFunction &)
+		{
+			return true;
+		}
 	};
 
 	struct BufferAccessHandler : OpcodeHandler
@@ -542,7 +696,7 @@ protected:
 
 	struct InterfaceVariableAccessHandler : OpcodeHandler
 	{
-		InterfaceVariableAccessHandler(const Compiler &compiler_, std::unordered_set<uint32_t> &variables_)
+		InterfaceVariableAccessHandler(const Compiler &compiler_, IDBitset &variables_)
 		    : compiler(compiler_)
 		    , variables(variables_)
 		{
@@ -551,7 +705,7 @@ protected:
 		bool handle(spv::Op opcode, const uint32_t *args, uint32_t length) override;
 
 		const Compiler &compiler;
-		std::unordered_set<uint32_t> &variables;
+		IDBitset &variables;
 	};
 
 	struct CombinedImageSamplerHandler : OpcodeHandler
@@ -563,6 +717,7 @@ protected:
 		bool handle(spv::Op opcode, const uint32_t *args, uint32_t length) override;
 		bool begin_function_scope(const uint32_t *args, uint32_t length) override;
 		bool end_function_scope(const uint32_t *args, uint32_t length) override;
+		bool handle_repeated_call(const SPIRFunction &func) override;
 
 		Compiler &compiler;
 
@@ -570,18 +725,34 @@ protected:
 		std::stack<std::unordered_map<uint32_t, uint32_t>> parameter_remapping;
 		std::stack<SPIRFunction *> functions;
 
+		// Every OpSampledImage reachable from a function, in terms of its own parameters and global variables.
+		// Replayed through the current parameter remapping when the function is called again.
+		struct SampledImage
+		{
+			uint32_t sampled_type;
+			uint32_t image_id;
+			uint32_t sampler_id;
+		};
+		std::unordered_map<uint32_t, std::vector<SampledImage>> function_sampled_images;
+
 		uint32_t remap_parameter(uint32_t id);
 		void push_remap_parameters(const SPIRFunction &func, const uint32_t *args, uint32_t length);
 		void pop_remap_parameters();
 		void register_combined_image_sampler(SPIRFunction &caller, uint32_t texture_id, uint32_t sampler_id);
+		void register_global_combined_image_sampler(uint32_t sampled_type, uint32_t image_id, uint32_t sampler_id);
+		void add_function_sampled_image(uint32_t func, const SampledImage &sampled);
 	};
 
-	bool traverse_all_reachable_opcodes(const SPIRBlock &block, OpcodeHandler &handler) const;
-	bool traverse_all_reachable_opcodes(const SPIRFunction &block, OpcodeHandler &handler) const;
+	// Calls handler for every opcode in func and the functions it calls. Each function body is only walked once.
+	bool traverse_all_reachable_opcodes(const SPIRFunction &func, OpcodeHandler &handler) const;
+	bool traverse_all_reachable_opcodes(const SPIRBlock &block, OpcodeHandler &handler,
+	                                    std::unordered_set<uint32_t> &traversed_functions) const;
+	bool traverse_all_reachable_opcodes(const SPIRFunction &func, OpcodeHandler &handler,
+	                                    std::unordered_set<uint32_t> &traversed_functions) const;
 	// This must be an ordered data structure so we always pick the same type aliases.
 	std::vector<uint32_t> global_struct_cache;
 
-	ShaderResources get_shader_resources(const std::unordered_set<uint32_t> *active_variables) const;
+	ShaderResources get_shader_resources(const IDBitset *active_variables) const;
 
 	VariableTypeRemapCallback variable_remap_callback;
 };
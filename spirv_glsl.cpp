@@ -18,6 +18,8 @@
 #include "GLSL.std.450.h"
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <thread>
 
 using namespace spv;
 using namespace spirv_cross;
@@ -264,14 +266,12 @@ void CompilerGLSL::find_static_extensions()
 
 string CompilerGLSL::compile()
 {
-	// Force a classic "C" locale, reverts when function returns
-	ClassicLocale classic_locale;
-
 	// Scan the SPIR-V to find trivial uses of extensions.
 	find_static_extensions();
 	fixup_image_load_store_access();
+	analyze_static_access();
 
-	uint32_t pass_count = 0;
+	pass_count = 0;
 	do
 	{
 		if (pass_count >= 3)
@@ -279,23 +279,49 @@ string CompilerGLSL::compile()
 
 		reset();
 
-		// Move constructor for this type is broken on GCC 4.9 ...
-		buffer = unique_ptr<ostringstream>(new ostringstream());
+		buffer.reset();
+		begin_pass_stats();
 
 		emit_header();
 		emit_resources();
 
+		analyze_variable_scopes();
 		emit_function(get<SPIRFunction>(entry_point), 0);
 
+		end_pass_stats();
 		pass_count++;
 	} while (force_recompile);
 
-	return buffer->str();
+	return buffer.release();
+}
+
+void CompilerGLSL::begin_pass_stats()
+{
+	if (!stats_enabled)
+		return;
+
+	if (pass_count == 0)
+		reset_compile_stats();
+	stats.passes.emplace_back();
+	pass_start = chrono::steady_clock::now();
+}
+
+void CompilerGLSL::end_pass_stats()
+{
+	if (!stats_enabled)
+		return;
+
+	auto &pass = stats.passes.back();
+	pass.emit_us = chrono::duration<double, micro>(chrono::steady_clock::now() - pass_start).count();
+	pass.emitted_bytes = buffer.size();
+	pass.forced_recompile = force_recompile;
+	stats.forced_temporaries = uint32_t(forced_temporaries.size());
+	stats.emitted_bytes = buffer.size();
 }
 
 std::string CompilerGLSL::get_partial_source()
 {
-	return buffer->str();
+	return buffer.str();
 }
 
 void CompilerGLSL::emit_header()
@@ -1013,10 +1039,8 @@ void CompilerGLSL::emit_buffer_block(const SPIRVariable &var)
 
 	// Shaders never use the block by interface name, so we don't
 	// have to track this other than updating name caches.
-	if (resource_names.find(buffer_name) != end(resource_names))
+	if (!resource_names.insert(names.intern(buffer_name)).second)
 		buffer_name = get_fallback_name(type.self);
-	else
-		resource_names.insert(buffer_name);
 
 	statement(layout_for_variable(var), is_restrict ? "restrict " : "", ssbo ? "buffer " : "uniform ", buffer_name);
 	begin_scope();
@@ -1062,10 +1086,8 @@ void CompilerGLSL::emit_interface_block(const SPIRVariable &var)
 
 		// Shaders never use the block by interface name, so we don't
 		// have to track this other than updating name caches.
-		if (resource_names.find(block_name) != end(resource_names))
+		if (!resource_names.insert(names.intern(block_name)).second)
 			block_name = get_fallback_name(type.self);
-		else
-			resource_names.insert(block_name);
 
 		statement(layout_for_variable(var), qual, block_name);
 		begin_scope();
@@ -1153,8 +1175,9 @@ void CompilerGLSL::replace_illegal_names()
 			if (!is_hidden_variable(var))
 			{
 				auto &m = meta[var.self].decoration;
-				if (m.alias.compare(0, 3, "gl_") == 0 || keywords.find(m.alias) != end(keywords))
-					m.alias = join("_", m.alias);
+				auto &name = names.get(m.alias);
+				if (name.compare(0, 3, "gl_") == 0 || keywords.find(name) != end(keywords))
+					m.alias = names.intern(join("_", name));
 			}
 		}
 	}
@@ -1174,7 +1197,7 @@ void CompilerGLSL::replace_fragment_output(SPIRVariable &var)
 	if (type.array.empty())
 	{
 		// Redirect the write to a specific render target in legacy GLSL.
-		m.alias = join("gl_FragData[", location, "]");
+		m.alias = names.intern(join("gl_FragData[", location, "]"));
 
 		if (is_legacy_es() && location != 0)
 			require_extension("GL_EXT_draw_buffers");
@@ -1184,7 +1207,7 @@ void CompilerGLSL::replace_fragment_output(SPIRVariable &var)
 		// If location is non-zero, we probably have to add an offset.
 		// This gets really tricky since we'd have to inject an offset in the access chain.
 		// FIXME: This seems like an extremely odd-ball case, so it's probably fine to leave it like this for now.
-		m.alias = "gl_FragData";
+		m.alias = names.intern("gl_FragData");
 		if (location != 0)
 			SPIRV_CROSS_THROW("Arrayed output variable used, but location is not 0. "
 			                  "This is unimplemented in SPIRV-Cross.");
@@ -1291,6 +1314,429 @@ void CompilerGLSL::fixup_image_load_store_access()
 	}
 }
 
+void CompilerGLSL::analyze_static_access()
+{
+	StaticAccessHandler handler(*this, entry_point);
+	traverse_all_reachable_opcodes(get<SPIRFunction>(entry_point), handler);
+
+	if (handler.image_atomics && options.es && options.version < 320)
+		require_extension("GL_OES_shader_image_atomic");
+
+	// Emission would forward these on the first pass, find out they are read twice and recompile.
+	// Reads which depend on forwarding decisions made during emission are still caught by track_expression_read().
+	for (auto &count : handler.read_counts)
+		if (count.second >= 2 && handler.usage_tracked.count(count.first) && !handler.uncounted.count(count.first))
+			forced_temporaries.insert(count.first);
+}
+
+// Mirrors how emission resolves backing variables through SPIRExpression::loaded_from.
+uint32_t CompilerGLSL::StaticAccessHandler::backing_variable(uint32_t id) const
+{
+	if (compiler.maybe_get<SPIRVariable>(id))
+		return id;
+
+	auto itr = backing_variables.find(id);
+	return itr != end(backing_variables) ? itr->second : 0;
+}
+
+void CompilerGLSL::StaticAccessHandler::mark_written(uint32_t id)
+{
+	uint32_t var = backing_variable(id);
+	if (!var)
+		return;
+
+	auto &func = compiler.get<SPIRFunction>(function_stack.back());
+	for (auto &arg : func.arguments)
+		if (arg.id == var && arg.write_count == 0)
+			arg.write_count++;
+}
+
+void CompilerGLSL::StaticAccessHandler::clear_image_flags(uint32_t id, uint64_t flags)
+{
+	uint32_t var = backing_variable(id);
+	if (var)
+		compiler.meta.at(var).decoration.decoration_flags &= ~flags;
+}
+
+bool CompilerGLSL::StaticAccessHandler::begin_function_scope(const uint32_t *args, uint32_t length)
+{
+	if (length < 3)
+		return false;
+
+	function_stack.push_back(args[2]);
+	return true;
+}
+
+bool CompilerGLSL::StaticAccessHandler::end_function_scope(const uint32_t *args, uint32_t length)
+{
+	if (length < 3)
+		return false;
+
+	function_stack.pop_back();
+
+	// The callee has been fully traversed, so we know which of its parameters it writes to.
+	auto &callee = compiler.get<SPIRFunction>(args[2]);
+	for (uint32_t i = 3; i < length && (i - 3) < callee.arguments.size(); i++)
+		if (callee.arguments[i - 3].write_count)
+			mark_written(args[i]);
+
+	return true;
+}
+
+void CompilerGLSL::StaticAccessHandler::set_current_block(const SPIRBlock &block)
+{
+	// Terminators and phi nodes are not part of the block's opcodes, but read their operands all the same.
+	if (block.terminator == SPIRBlock::Select || block.terminator == SPIRBlock::MultiSelect)
+		count_reads(&block.condition, 1);
+	if (block.return_value)
+		count_reads(&block.return_value, 1);
+	for (auto &phi : block.phi_variables)
+		count_reads(&phi.local_variable, 1);
+}
+
+void CompilerGLSL::StaticAccessHandler::count_reads(const uint32_t *args, uint32_t length)
+{
+	for (uint32_t i = 0; i < length; i++)
+		read_counts[args[i]]++;
+}
+
+// Counts the reads emission makes of each operand. Words which are not IDs may be counted too,
+// which is harmless as long as they do not name a result in usage_tracked.
+void CompilerGLSL::StaticAccessHandler::count_reads(Op opcode, const uint32_t *args, uint32_t length)
+{
+	// Index of an image operands or memory access mask, which is a literal.
+	uint32_t mask_index = 0;
+
+	switch (opcode)
+	{
+	case OpSNegate:
+	case OpFNegate:
+	case OpIAdd:
+	case OpFAdd:
+	case OpISub:
+	case OpFSub:
+	case OpIMul:
+	case OpFMul:
+	case OpUDiv:
+	case OpSDiv:
+	case OpFDiv:
+	case OpUMod:
+	case OpSMod:
+	case OpFMod:
+	case OpVectorTimesScalar:
+	case OpMatrixTimesScalar:
+	case OpVectorTimesMatrix:
+	case OpMatrixTimesVector:
+	case OpMatrixTimesMatrix:
+	case OpOuterProduct:
+	case OpDot:
+	case OpTranspose:
+	case OpShiftRightLogical:
+	case OpShiftRightArithmetic:
+	case OpShiftLeftLogical:
+	case OpBitwiseOr:
+	case OpBitwiseXor:
+	case OpBitwiseAnd:
+	case OpNot:
+	case OpBitFieldInsert:
+	case OpBitFieldSExtract:
+	case OpBitFieldUExtract:
+	case OpBitReverse:
+	case OpBitCount:
+	case OpLogicalOr:
+	case OpLogicalAnd:
+	case OpLogicalNot:
+	case OpLogicalEqual:
+	case OpLogicalNotEqual:
+	case OpSelect:
+	case OpIEqual:
+	case OpINotEqual:
+	case OpUGreaterThan:
+	case OpSGreaterThan:
+	case OpUGreaterThanEqual:
+	case OpSGreaterThanEqual:
+	case OpULessThan:
+	case OpSLessThan:
+	case OpULessThanEqual:
+	case OpSLessThanEqual:
+	case OpFOrdEqual:
+	case OpFUnordEqual:
+	case OpFOrdNotEqual:
+	case OpFUnordNotEqual:
+	case OpFOrdLessThan:
+	case OpFUnordLessThan:
+	case OpFOrdGreaterThan:
+	case OpFUnordGreaterThan:
+	case OpFOrdLessThanEqual:
+	case OpFUnordLessThanEqual:
+	case OpFOrdGreaterThanEqual:
+	case OpFUnordGreaterThanEqual:
+	case OpConvertFToU:
+	case OpConvertFToS:
+	case OpConvertSToF:
+	case OpConvertUToF:
+	case OpUConvert:
+	case OpSConvert:
+	case OpFConvert:
+	case OpBitcast:
+	case OpIsNan:
+	case OpIsInf:
+	case OpAny:
+	case OpAll:
+	case OpDPdx:
+	case OpDPdy:
+	case OpFwidth:
+	case OpDPdxFine:
+	case OpDPdyFine:
+	case OpFwidthFine:
+	case OpDPdxCoarse:
+	case OpDPdyCoarse:
+	case OpFwidthCoarse:
+	case OpVectorExtractDynamic:
+	case OpFunctionCall:
+		if (length < 2)
+			return;
+		result_types[args[1]] = args[0];
+		usage_tracked.insert(args[1]);
+		count_reads(args + 2, length - 2);
+		return;
+
+	case OpCompositeConstruct:
+	{
+		if (length < 3)
+			return;
+		result_types[args[1]] = args[0];
+		usage_tracked.insert(args[1]);
+
+		// Vectors built from one repeated scalar are emitted as a splat, which reads the scalar once.
+		auto &type = compiler.get<SPIRType>(args[0]);
+		bool splat = compiler.backend.use_constructor_splatting && type.array.empty() &&
+		             type.basetype != SPIRType::Struct && type.columns == 1 && type.vecsize == length - 2;
+		for (uint32_t i = 3; splat && i < length; i++)
+			splat = args[i] == args[2];
+
+		count_reads(args + 2, splat ? 1 : length - 2);
+		return;
+	}
+
+	case OpExtInst:
+		if (length < 4)
+			return;
+		result_types[args[1]] = args[0];
+		if (compiler.get<SPIRExtension>(args[2]).ext == SPIRExtension::GLSL)
+			usage_tracked.insert(args[1]);
+		count_reads(args + 4, length - 4);
+		return;
+
+	case OpVectorShuffle:
+	{
+		if (length < 4)
+			return;
+		result_types[args[1]] = args[0];
+
+		// Components taken from the first vector only are emitted as one swizzle of it.
+		uint32_t vecsize = type_vecsize(args[2]);
+		if (!vecsize)
+		{
+			count_reads(args + 2, 1);
+			uncounted.insert(args[3]);
+			return;
+		}
+
+		bool shuffle = false;
+		for (uint32_t i = 4; i < length; i++)
+			if (args[i] >= vecsize)
+				shuffle = true;
+
+		if (shuffle)
+			for (uint32_t i = 4; i < length; i++)
+				count_reads(args + (args[i] >= vecsize ? 3 : 2), 1);
+		else
+			count_reads(args + 2, 1);
+		return;
+	}
+
+	case OpCompositeExtract:
+		if (length < 3)
+			return;
+		result_types[args[1]] = args[0];
+
+		// Emission may split scalar extracts from their base and merge several of them into one swizzle.
+		uncounted.insert(args[2]);
+		return;
+
+	case OpCompositeInsert:
+		if (length < 4)
+			return;
+		result_types[args[1]] = args[0];
+
+		// The composite is read once for the member written and once more for the result.
+		count_reads(args + 2, 1);
+		count_reads(args + 3, 1);
+		count_reads(args + 3, 1);
+		return;
+
+	case OpImageSampleImplicitLod:
+	case OpImageSampleExplicitLod:
+	case OpImageFetch:
+		if (length < 4)
+			return;
+		result_types[args[1]] = args[0];
+		usage_tracked.insert(args[1]);
+		mask_index = 4;
+		break;
+
+	case OpImageSampleDrefImplicitLod:
+	case OpImageSampleDrefExplicitLod:
+	case OpImageSampleProjImplicitLod:
+	case OpImageSampleProjExplicitLod:
+	case OpImageSampleProjDrefImplicitLod:
+	case OpImageSampleProjDrefExplicitLod:
+	case OpImageGather:
+	case OpImageDrefGather:
+		// Coordinates and references may be merged or swizzled, so their reads are not counted.
+		for (uint32_t i = 2; i < length; i++)
+			uncounted.insert(args[i]);
+		return;
+
+	case OpImageRead:
+		mask_index = 4;
+		break;
+
+	case OpImageWrite:
+		mask_index = 3;
+		break;
+
+	case OpLoad:
+		mask_index = 3;
+		break;
+
+	case OpStore:
+		mask_index = 2;
+		break;
+
+	default:
+		break;
+	}
+
+	// The remaining opcodes read each operand once.
+	if (mask_index && mask_index < length)
+	{
+		count_reads(args, mask_index);
+		count_reads(args + mask_index + 1, length - mask_index - 1);
+	}
+	else
+		count_reads(args, length);
+}
+
+uint32_t CompilerGLSL::StaticAccessHandler::type_vecsize(uint32_t id) const
+{
+	uint32_t type = 0;
+	auto itr = result_types.find(id);
+	if (itr != end(result_types))
+		type = itr->second;
+	else if (auto *c = compiler.maybe_get<SPIRConstant>(id))
+		type = c->constant_type;
+	else if (auto *var = compiler.maybe_get<SPIRVariable>(id))
+		type = var->basetype;
+	else if (auto *undef = compiler.maybe_get<SPIRUndef>(id))
+		type = undef->basetype;
+
+	return type ? compiler.get<SPIRType>(type).vecsize : 0;
+}
+
+bool CompilerGLSL::StaticAccessHandler::handle(Op opcode, const uint32_t *args, uint32_t length)
+{
+	count_reads(opcode, args, length);
+
+	switch (opcode)
+	{
+	case OpLoad:
+	case OpImageTexelPointer:
+	{
+		if (length < 3)
+			return false;
+
+		uint32_t var = backing_variable(args[2]);
+		if (var)
+			backing_variables[args[1]] = var;
+		if (opcode == OpImageTexelPointer)
+			image_texel_pointers.insert(args[1]);
+		break;
+	}
+
+	case OpAccessChain:
+	case OpInBoundsAccessChain:
+		if (length < 3)
+			return false;
+
+		// Access chains only refer back to their immediate base.
+		if (compiler.maybe_get<SPIRVariable>(args[2]))
+			backing_variables[args[1]] = args[2];
+		break;
+
+	case OpStore:
+	case OpCopyMemory:
+		if (length < 2)
+			return false;
+		mark_written(args[0]);
+		break;
+
+	case OpExtInst:
+	{
+		if (length < 4)
+			return false;
+
+		auto &ext = compiler.get<SPIRExtension>(args[2]);
+		if (ext.ext == SPIRExtension::GLSL && (args[3] == GLSLstd450Modf || args[3] == GLSLstd450Frexp))
+		{
+			if (length < 6)
+				return false;
+			mark_written(args[5]);
+		}
+		break;
+	}
+
+	case OpImageRead:
+		if (length < 3)
+			return false;
+		clear_image_flags(args[2], 1ull << DecorationNonReadable);
+		break;
+
+	case OpImageWrite:
+		if (length < 1)
+			return false;
+		clear_image_flags(args[0], 1ull << DecorationNonWritable);
+		break;
+
+	case OpAtomicExchange:
+	case OpAtomicCompareExchange:
+	case OpAtomicIAdd:
+	case OpAtomicISub:
+	case OpAtomicSMin:
+	case OpAtomicUMin:
+	case OpAtomicSMax:
+	case OpAtomicUMax:
+	case OpAtomicAnd:
+	case OpAtomicOr:
+	case OpAtomicXor:
+		if (length < 3)
+			return false;
+
+		if (image_texel_pointers.count(args[2]))
+		{
+			image_atomics = true;
+			clear_image_flags(args[2], (1ull << DecorationNonWritable) | (1ull << DecorationNonReadable));
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return true;
+}
+
 void CompilerGLSL::emit_resources()
 {
 	auto &execution = get_entry_point();
@@ -1508,11 +1954,11 @@ void CompilerGLSL::strip_enclosed_expression(string &expr)
 	expr.erase(begin(expr));
 }
 
-// Just like to_expression except that we enclose the expression inside parentheses if needed.
-string CompilerGLSL::to_enclosed_expression(uint32_t id)
+// If this expression contains any spaces which are not enclosed by parentheses,
+// we need to enclose it so we can treat the whole string as an expression.
+// This happens when two expressions have been part of a binary op earlier.
+bool CompilerGLSL::needs_enclose_expression(const string &expr)
 {
-	auto expr = to_expression(id);
-	bool need_parens = false;
 	uint32_t paren_count = 0;
 	for (auto c : expr)
 	{
@@ -1524,16 +1970,34 @@ string CompilerGLSL::to_enclosed_expression(uint32_t id)
 			paren_count--;
 		}
 		else if (c == ' ' && paren_count == 0)
+			return true;
+	}
+	assert(paren_count == 0);
+	return false;
+}
+
+// Just like to_expression except that we enclose the expression inside parentheses if needed.
+string CompilerGLSL::to_enclosed_expression(uint32_t id)
+{
+	auto expr = to_expression(id);
+
+	// Forwarded expressions can be referenced many times as parts of ever longer expressions,
+	// so remember the answer instead of scanning them again on every use.
+	// Any base expression is enclosed already, so only our own part of the string matters.
+	bool need_parens;
+	auto *e = maybe_get<SPIRExpression>(id);
+	if (e)
+	{
+		if (e->enclose == SPIRExpression::EncloseUnknown)
 		{
-			need_parens = true;
-			break;
+			e->enclose = needs_enclose_expression(e->expression) ? SPIRExpression::EncloseNeeded :
+			                                                       SPIRExpression::EncloseNotNeeded;
 		}
+		need_parens = e->enclose == SPIRExpression::EncloseNeeded;
 	}
-	assert(paren_count == 0);
+	else
+		need_parens = needs_enclose_expression(expr);
 
-	// If this expression contains any spaces which are not enclosed by parentheses,
-	// we need to enclose it so we can treat the whole string as an expression.
-	// This happens when two expressions have been part of a binary op earlier.
 	if (need_parens)
 		return join('(', expr, ')');
 	else
@@ -1542,8 +2006,7 @@ string CompilerGLSL::to_enclosed_expression(uint32_t id)
 
 string CompilerGLSL::to_expression(uint32_t id)
 {
-	auto itr = invalid_expressions.find(id);
-	if (itr != end(invalid_expressions))
+	if (invalid_expressions.count(id))
 		handle_invalid_expression(id);
 
 	if (ids[id].get_type() == TypeExpression)
@@ -1561,7 +2024,7 @@ string CompilerGLSL::to_expression(uint32_t id)
 		// and see that we should not forward reads of the original variable.
 		auto &expr = get<SPIRExpression>(id);
 		for (uint32_t dep : expr.expression_dependencies)
-			if (invalid_expressions.find(dep) != end(invalid_expressions))
+			if (invalid_expressions.count(dep))
 				handle_invalid_expression(dep);
 	}
 
@@ -2006,13 +2469,17 @@ string CompilerGLSL::declare_temporary(uint32_t result_type, uint32_t result_id)
 
 bool CompilerGLSL::expression_is_forwarded(uint32_t id)
 {
-	return forwarded_temporaries.find(id) != end(forwarded_temporaries);
+	return forwarded_temporaries.count(id);
 }
 
 SPIRExpression &CompilerGLSL::emit_op(uint32_t result_type, uint32_t result_id, const string &rhs, bool forwarding,
                                       bool suppress_usage_tracking)
 {
-	if (forwarding && (forced_temporaries.find(result_id) == end(forced_temporaries)))
+	// Callers check forced_temporaries to see whether the result was forwarded, so spill through it.
+	if (forwarding && options.max_forwarded_expression_size && rhs.size() > options.max_forwarded_expression_size)
+		forced_temporaries.insert(result_id);
+
+	if (forwarding && (!forced_temporaries.count(result_id)))
 	{
 		// Just forward it without temporary.
 		// If the forward is trivial, we do not force flushing to temporary for this expression.
@@ -2025,27 +2492,34 @@ SPIRExpression &CompilerGLSL::emit_op(uint32_t result_type, uint32_t result_id,
 	{
 		// If expression isn't immutable, bind it to a temporary and make the new temporary immutable (they always are).
 		statement(declare_temporary(result_type, result_id), rhs, ";");
-		return set<SPIRExpression>(result_id, to_name(result_id), result_type, true);
+		auto &e = set<SPIRExpression>(result_id, to_name(result_id), result_type, true);
+		e.enclose = SPIRExpression::EncloseNotNeeded;
+		return e;
 	}
 }
 
 void CompilerGLSL::emit_unary_op(uint32_t result_type, uint32_t result_id, uint32_t op0, const char *op)
 {
 	bool forward = should_forward(op0);
-	emit_op(result_type, result_id, join(op, to_enclosed_expression(op0)), forward);
+	auto &e = emit_op(result_type, result_id, join(op, to_enclosed_expression(op0)), forward);
 
-	if (forward && forced_temporaries.find(result_id) == end(forced_temporaries))
+	if (forward && !forced_temporaries.count(result_id))
+	{
+		e.enclose = SPIRExpression::EncloseNotNeeded;
 		inherit_expression_dependencies(result_id, op0);
+	}
 }
 
 void CompilerGLSL::emit_binary_op(uint32_t result_type, uint32_t result_id, uint32_t op0, uint32_t op1, const char *op)
 {
 	bool forward = should_forward(op0) && should_forward(op1);
-	emit_op(result_type, result_id, join(to_enclosed_expression(op0), " ", op, " ", to_enclosed_expression(op1)),
-	        forward);
+	auto &e = emit_op(result_type, result_id,
+	                  join(to_enclosed_expression(op0), " ", op, " ", to_enclosed_expression(op1)), forward);
 
-	if (forward && forced_temporaries.find(result_id) == end(forced_temporaries))
+	if (forward && !forced_temporaries.count(result_id))
 	{
+		// The operands are enclosed, so the spaces around the operator are never inside parentheses.
+		e.enclose = SPIRExpression::EncloseNeeded;
 		inherit_expression_dependencies(result_id, op0);
 		inherit_expression_dependencies(result_id, op1);
 	}
@@ -2097,36 +2571,49 @@ void CompilerGLSL::emit_binary_op_cast(uint32_t result_type, uint32_t result_id,
 	// For example, arithmetic right shift with uint inputs.
 	// Special case boolean outputs since relational opcodes output booleans instead of int/uint.
 	string expr;
+	bool need_parens;
 	if (out_type.basetype != input_type && out_type.basetype != SPIRType::Boolean)
 	{
 		expected_type.basetype = input_type;
 		expr = bitcast_glsl_op(out_type, expected_type);
+		need_parens = needs_enclose_expression(expr);
 		expr += '(';
 		expr += join(cast_op0, " ", op, " ", cast_op1);
 		expr += ')';
 	}
 	else
+	{
 		expr += join(cast_op0, " ", op, " ", cast_op1);
+		need_parens = true;
+	}
 
-	emit_op(result_type, result_id, expr, should_forward(op0) && should_forward(op1));
+	bool forward = should_forward(op0) && should_forward(op1);
+	auto &e = emit_op(result_type, result_id, expr, forward);
+	if (forward && !forced_temporaries.count(result_id))
+		e.enclose = need_parens ? SPIRExpression::EncloseNeeded : SPIRExpression::EncloseNotNeeded;
 }
 
 void CompilerGLSL::emit_unary_func_op(uint32_t result_type, uint32_t result_id, uint32_t op0, const char *op)
 {
 	bool forward = should_forward(op0);
-	emit_op(result_type, result_id, join(op, "(", to_expression(op0), ")"), forward);
-	if (forward && forced_temporaries.find(result_id) == end(forced_temporaries))
+	auto &e = emit_op(result_type, result_id, join(op, "(", to_expression(op0), ")"), forward);
+	if (forward && !forced_temporaries.count(result_id))
+	{
+		e.enclose = SPIRExpression::EncloseNotNeeded;
 		inherit_expression_dependencies(result_id, op0);
+	}
 }
 
 void CompilerGLSL::emit_binary_func_op(uint32_t result_type, uint32_t result_id, uint32_t op0, uint32_t op1,
                                        const char *op)
 {
 	bool forward = should_forward(op0) && should_forward(op1);
-	emit_op(result_type, result_id, join(op, "(", to_expression(op0), ", ", to_expression(op1), ")"), forward);
+	auto &e =
+	    emit_op(result_type, result_id, join(op, "(", to_expression(op0), ", ", to_expression(op1), ")"), forward);
 
-	if (forward && forced_temporaries.find(result_id) == end(forced_temporaries))
+	if (forward && !forced_temporaries.count(result_id))
 	{
+		e.enclose = SPIRExpression::EncloseNotNeeded;
 		inherit_expression_dependencies(result_id, op0);
 		inherit_expression_dependencies(result_id, op1);
 	}
@@ -2161,11 +2648,13 @@ void CompilerGLSL::emit_trinary_func_op(uint32_t result_type, uint32_t result_id
                                         uint32_t op2, const char *op)
 {
 	bool forward = should_forward(op0) && should_forward(op1) && should_forward(op2);
-	emit_op(result_type, result_id,
-	        join(op, "(", to_expression(op0), ", ", to_expression(op1), ", ", to_expression(op2), ")"), forward);
+	auto &e = emit_op(result_type, result_id,
+	                  join(op, "(", to_expression(op0), ", ", to_expression(op1), ", ", to_expression(op2), ")"),
+	                  forward);
 
-	if (forward && forced_temporaries.find(result_id) == end(forced_temporaries))
+	if (forward && !forced_temporaries.count(result_id))
 	{
+		e.enclose = SPIRExpression::EncloseNotNeeded;
 		inherit_expression_dependencies(result_id, op0);
 		inherit_expression_dependencies(result_id, op1);
 		inherit_expression_dependencies(result_id, op2);
@@ -2176,12 +2665,13 @@ void CompilerGLSL::emit_quaternary_func_op(uint32_t result_type, uint32_t result
                                            uint32_t op2, uint32_t op3, const char *op)
 {
 	bool forward = should_forward(op0) && should_forward(op1) && should_forward(op2) && should_forward(op3);
-	emit_op(result_type, result_id, join(op, "(", to_expression(op0), ", ", to_expression(op1), ", ",
-	                                     to_expression(op2), ", ", to_expression(op3), ")"),
-	        forward);
+	auto &e = emit_op(result_type, result_id, join(op, "(", to_expression(op0), ", ", to_expression(op1), ", ",
+	                                               to_expression(op2), ", ", to_expression(op3), ")"),
+	                  forward);
 
-	if (forward && forced_temporaries.find(result_id) == end(forced_temporaries))
+	if (forward && !forced_temporaries.count(result_id))
 	{
+		e.enclose = SPIRExpression::EncloseNotNeeded;
 		inherit_expression_dependencies(result_id, op0);
 		inherit_expression_dependencies(result_id, op1);
 		inherit_expression_dependencies(result_id, op2);
@@ -2421,7 +2911,7 @@ void CompilerGLSL::emit_texture_op(const Instruction &i)
 	auto op = static_cast<Op>(i.op);
 	uint32_t length = i.length;
 
-	if (i.offset + length > spirv.size())
+	if (i.offset + length > spirv_word_count)
 		SPIRV_CROSS_THROW("Compiler::parse() opcode out of range.");
 
 	uint32_t result_type = ops[0];
@@ -3253,7 +3743,7 @@ void CompilerGLSL::track_expression_read(uint32_t id)
 
 bool CompilerGLSL::args_will_forward(uint32_t id, const uint32_t *args, uint32_t num_args, bool pure)
 {
-	if (forced_temporaries.find(id) != end(forced_temporaries))
+	if (forced_temporaries.count(id))
 		return false;
 
 	for (uint32_t i = 0; i < num_args; i++)
@@ -3552,7 +4042,7 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 		// If we're loading from memory that cannot be changed by the shader,
 		// just forward the expression directly to avoid needless temporaries.
 		// If an expression is mutable and forwardable, we speculate that it is immutable.
-		bool forward = should_forward(ptr) && forced_temporaries.find(id) == end(forced_temporaries);
+		bool forward = should_forward(ptr) && !forced_temporaries.count(id);
 
 		// If loading a non-native row-major matrix, convert it to column-major
 		auto expr = to_expression(ptr);
@@ -3694,7 +4184,7 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 			// In order to avoid start tracking invalid variables,
 			// just avoid the forwarding problem altogether.
 			bool forward = args_will_forward(id, arg, length, pure) && !callee_has_out_variables && pure &&
-			               (forced_temporaries.find(id) == end(forced_temporaries));
+			               (!forced_temporaries.count(id));
 
 			emit_op(result_type, id, funexpr, forward);
 
@@ -3808,7 +4298,7 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 		auto &type = get<SPIRType>(result_type);
 
 		// We can only split the expression here if our expression is forwarded as a temporary.
-		bool allow_base_expression = forced_temporaries.find(id) == end(forced_temporaries);
+		bool allow_base_expression = !forced_temporaries.count(id);
 
 		// Only apply this optimization if result is scalar.
 		if (allow_base_expression && should_forward(ops[2]) && type.vecsize == 1 && type.columns == 1 && length == 1)
@@ -3867,6 +4357,8 @@ void CompilerGLSL::emit_instruction(const Instruction &instruction)
 			register_read(id, composite, true);
 			// Invalidate the old expression we inserted into.
 			invalid_expressions.insert(composite);
+			if (stats_enabled)
+				stats.invalidated_expressions++;
 		}
 		break;
 	}
@@ -4825,8 +5317,8 @@ void CompilerGLSL::append_global_func_args(const SPIRFunction &func, uint32_t in
 string CompilerGLSL::to_member_name(const SPIRType &type, uint32_t index)
 {
 	auto &memb = meta[type.self].members;
-	if (index < memb.size() && !memb[index].alias.empty())
-		return memb[index].alias;
+	if (index < memb.size() && memb[index].alias != 0)
+		return names.get(memb[index].alias);
 	else
 		return join("_", index);
 }
@@ -4834,16 +5326,15 @@ string CompilerGLSL::to_member_name(const SPIRType &type, uint32_t index)
 void CompilerGLSL::add_member_name(SPIRType &type, uint32_t index)
 {
 	auto &memb = meta[type.self].members;
-	if (index < memb.size() && !memb[index].alias.empty())
+	if (index < memb.size() && memb[index].alias != 0)
 	{
 		auto &name = memb[index].alias;
-		if (name.empty())
-			return;
 
 		// Reserved for temporaries.
-		if (name[0] == '_' && name.size() >= 2 && isdigit(name[1]))
+		auto &str = names.get(name);
+		if (str[0] == '_' && str.size() >= 2 && isdigit(str[1]))
 		{
-			name.clear();
+			name = 0;
 			return;
 		}
 
@@ -5297,16 +5788,17 @@ string CompilerGLSL::type_to_glsl(const SPIRType &type)
 	}
 }
 
-void CompilerGLSL::add_variable(unordered_set<string> &variables, uint32_t id)
+void CompilerGLSL::add_variable(unordered_set<uint32_t> &variables, uint32_t id)
 {
 	auto &name = meta[id].decoration.alias;
-	if (name.empty())
+	if (name == 0)
 		return;
 
 	// Reserved for temporaries.
-	if (name[0] == '_' && name.size() >= 2 && isdigit(name[1]))
+	auto &str = names.get(name);
+	if (str[0] == '_' && str.size() >= 2 && isdigit(str[1]))
 	{
-		name.clear();
+		name = 0;
 		return;
 	}
 
@@ -5337,6 +5829,48 @@ void CompilerGLSL::require_extension(const string &ext)
 	}
 }
 
+void CompilerGLSL::hash_options(Hasher &hasher, const Options &opts)
+{
+	hasher.u32(opts.version);
+	hasher.u32(opts.es);
+	hasher.u32(opts.force_temporary);
+	hasher.u32(opts.cfg_analysis);
+	hasher.u32(opts.max_forwarded_expression_size);
+	hasher.u32(opts.vulkan_semantics);
+	hasher.u32(opts.use_oes_egl_image_for_videos);
+	hasher.u32(opts.vertex.fixup_clipspace);
+	hasher.u32(opts.fragment.default_float_precision);
+	hasher.u32(opts.fragment.default_int_precision);
+}
+
+void CompilerGLSL::hash_compile_state(Hasher &hasher) const
+{
+	Compiler::hash_compile_state(hasher);
+
+	hasher.string("glsl");
+	hash_options(hasher, options);
+
+	for (auto *remaps : { &pls_inputs, &pls_outputs })
+	{
+		hasher.u32(uint32_t(remaps->size()));
+		for (auto &remap : *remaps)
+		{
+			hasher.u32(remap.id);
+			hasher.u32(remap.format);
+		}
+	}
+
+	hasher.u32(uint32_t(header_lines.size()));
+	for (auto &line : header_lines)
+		hasher.string(line);
+
+	vector<string> extensions(begin(forced_extensions), end(forced_extensions));
+	sort(begin(extensions), end(extensions));
+	hasher.u32(uint32_t(extensions.size()));
+	for (auto &ext : extensions)
+		hasher.string(ext);
+}
+
 bool CompilerGLSL::check_atomic_image(uint32_t id)
 {
 	auto &type = expression_type(id);
@@ -5426,6 +5960,133 @@ void CompilerGLSL::emit_function_prototype(SPIRFunction &func, uint64_t return_f
 	statement(decl);
 }
 
+void CompilerGLSL::analyze_variable_scopes()
+{
+	if (!options.cfg_analysis || options.cfg_analysis_threads < 2)
+		return;
+
+	// Gather the functions reachable from the entry point which still need analysis.
+	vector<SPIRFunction *> functions;
+	unordered_set<uint32_t> seen_functions;
+	vector<uint32_t> stack = { entry_point };
+	seen_functions.insert(entry_point);
+	while (!stack.empty())
+	{
+		auto &func = get<SPIRFunction>(stack.back());
+		stack.pop_back();
+		if (!func.analyzed_variable_scope)
+			functions.push_back(&func);
+
+		for (auto block : func.blocks)
+		{
+			for (auto &i : get<SPIRBlock>(block).ops)
+			{
+				if (static_cast<Op>(i.op) != OpFunctionCall)
+					continue;
+
+				uint32_t callee = stream(i)[2];
+				if (seen_functions.insert(callee).second)
+					stack.push_back(callee);
+			}
+		}
+	}
+
+	if (functions.empty())
+		return;
+
+	// Every function writes only to its own blocks and variables, so functions are handed out
+	// to workers one at a time and the results do not depend on which worker got which function.
+	// Timings are collected per worker and summed, so they add up the time spent on every thread.
+	unsigned worker_count = unsigned(min<size_t>(options.cfg_analysis_threads, functions.size()));
+	vector<CompilerStats> worker_stats(worker_count);
+	atomic<size_t> next_function{ 0 };
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+	vector<exception_ptr> errors(worker_count);
+#endif
+
+	const auto work = [&](unsigned worker) {
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+		try
+#endif
+		{
+			auto *timing = stats_enabled ? &worker_stats[worker] : nullptr;
+			for (size_t index = next_function++; index < functions.size(); index = next_function++)
+				analyze_function_variable_scope(*functions[index], timing);
+		}
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+		catch (...)
+		{
+			errors[worker] = current_exception();
+			// Make the other workers run dry.
+			next_function = functions.size();
+		}
+#endif
+	};
+
+	// The calling thread acts as worker 0.
+	vector<thread> workers;
+	for (unsigned i = 1; i < worker_count; i++)
+		workers.emplace_back(work, i);
+	work(0);
+	for (auto &worker : workers)
+		worker.join();
+
+#ifndef SPIRV_CROSS_EXCEPTIONS_TO_ASSERTIONS
+	for (auto &error : errors)
+		if (error)
+			rethrow_exception(error);
+#endif
+
+	for (auto &timing : worker_stats)
+	{
+		stats.variable_scope_us += timing.variable_scope_us;
+		stats.cfg_us += timing.cfg_us;
+	}
+}
+
+void CompilerGLSL::analyze_function_variable_scope(SPIRFunction &func, CompilerStats *timing)
+{
+	if (func.analyzed_variable_scope)
+		return;
+
+	if (options.cfg_analysis)
+	{
+		analyze_variable_scope(func, timing);
+
+		// Check if we can actually use the loop variables we found in analyze_variable_scope.
+		// To use multiple initializers, we need the same type and qualifiers.
+		for (auto block : func.blocks)
+		{
+			auto &b = get<SPIRBlock>(block);
+			if (b.loop_variables.size() < 2)
+				continue;
+
+			uint64_t flags = get_decoration_mask(b.loop_variables.front());
+			uint32_t type = get<SPIRVariable>(b.loop_variables.front()).basetype;
+			bool invalid_initializers = false;
+			for (auto loop_variable : b.loop_variables)
+			{
+				if (flags != get_decoration_mask(loop_variable) ||
+				    type != get<SPIRVariable>(b.loop_variables.front()).basetype)
+				{
+					invalid_initializers = true;
+					break;
+				}
+			}
+
+			if (invalid_initializers)
+			{
+				for (auto loop_variable : b.loop_variables)
+					get<SPIRVariable>(loop_variable).loop_variable = false;
+				b.loop_variables.clear();
+			}
+		}
+	}
+	else
+		get<SPIRBlock>(func.entry_block).dominated_variables = func.local_variables;
+	func.analyzed_variable_scope = true;
+}
+
 void CompilerGLSL::emit_function(SPIRFunction &func, uint64_t return_flags)
 {
 	// Avoid potential cycles.
@@ -5451,51 +6112,16 @@ void CompilerGLSL::emit_function(SPIRFunction &func, uint64_t return_flags)
 		}
 	}
 
+	// Callees have been emitted, so only this function is measured from here on.
+	StatsTimer timer(stats_enabled ? &get_function_stats(func.self).emit_us : nullptr);
+
 	emit_function_prototype(func, return_flags);
 	begin_scope();
 
 	current_function = &func;
 	auto &entry_block = get<SPIRBlock>(func.entry_block);
 
-	if (!func.analyzed_variable_scope)
-	{
-		if (options.cfg_analysis)
-		{
-			analyze_variable_scope(func);
-
-			// Check if we can actually use the loop variables we found in analyze_variable_scope.
-			// To use multiple initializers, we need the same type and qualifiers.
-			for (auto block : func.blocks)
-			{
-				auto &b = get<SPIRBlock>(block);
-				if (b.loop_variables.size() < 2)
-					continue;
-
-				uint64_t flags = get_decoration_mask(b.loop_variables.front());
-				uint32_t type = get<SPIRVariable>(b.loop_variables.front()).basetype;
-				bool invalid_initializers = false;
-				for (auto loop_variable : b.loop_variables)
-				{
-					if (flags != get_decoration_mask(loop_variable) ||
-					    type != get<SPIRVariable>(b.loop_variables.front()).basetype)
-					{
-						invalid_initializers = true;
-						break;
-					}
-				}
-
-				if (invalid_initializers)
-				{
-					for (auto loop_variable : b.loop_variables)
-						get<SPIRVariable>(loop_variable).loop_variable = false;
-					b.loop_variables.clear();
-				}
-			}
-		}
-		else
-			entry_block.dominated_variables = func.local_variables;
-		func.analyzed_variable_scope = true;
-	}
+	analyze_function_variable_scope(func, stats_enabled ? &stats : nullptr);
 
 	for (auto &v : func.local_variables)
 	{
@@ -5573,7 +6199,7 @@ void CompilerGLSL::branch(uint32_t from, uint32_t to)
 	flush_all_active_variables();
 
 	// This is only a continue if we branch to our loop dominator.
-	if (loop_blocks.find(to) != end(loop_blocks) && get<SPIRBlock>(from).loop_dominator == to)
+	if (loop_blocks.count(to) && get<SPIRBlock>(from).loop_dominator == to)
 	{
 		// This can happen if we had a complex continue block which was emitted.
 		// Once the continue block tries to branch to the loop header, just emit continue;
@@ -5722,7 +6348,7 @@ string CompilerGLSL::emit_continue_block(uint32_t continue_block)
 	redirect_statement = &statements;
 
 	// Stamp out all blocks one after each other.
-	while (loop_blocks.find(block->self) == end(loop_blocks))
+	while (!loop_blocks.count(block->self))
 	{
 		propagate_loop_dominators(*block);
 		// Write out all instructions we have in this block.
@@ -5801,7 +6427,7 @@ bool CompilerGLSL::attempt_emit_loop_header(SPIRBlock &block, SPIRBlock::Method
 		for (auto &op : block.ops)
 			emit_instruction(op);
 
-		bool condition_is_temporary = forced_temporaries.find(block.condition) == end(forced_temporaries);
+		bool condition_is_temporary = !forced_temporaries.count(block.condition);
 
 		// This can work! We only did trivial things which could be forwarded in block body!
 		if (current_count == statement_count && condition_is_temporary)
@@ -5847,7 +6473,7 @@ bool CompilerGLSL::attempt_emit_loop_header(SPIRBlock &block, SPIRBlock::Method
 		for (auto &op : child.ops)
 			emit_instruction(op);
 
-		bool condition_is_temporary = forced_temporaries.find(child.condition) == end(forced_temporaries);
+		bool condition_is_temporary = !forced_temporaries.count(child.condition);
 
 		if (current_count == statement_count && condition_is_temporary)
 		{
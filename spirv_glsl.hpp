@@ -63,6 +63,17 @@ public:
 		// If true, variables will be moved to their appropriate scope through CFG analysis.
 		bool cfg_analysis = true;
 
+		// If greater than one, CFG analysis of every function reachable from the entry point is done up front
+		// on this many threads, rather than one function at a time as they are emitted.
+		// The output does not depend on the thread count.
+		uint32_t cfg_analysis_threads = 1;
+
+		// If non-zero, an expression which would be forwarded into its users is stored in a temporary
+		// instead once its text is longer than this many characters.
+		// This keeps long chains of single-use operations from turning into one huge line,
+		// which is slow to build here and slow for the driver to compile later.
+		uint32_t max_forwarded_expression_size = 0;
+
 		// If true, Vulkan GLSL features are used instead of GL-compatible features.
 		// Mostly useful for debugging SPIR-V files.
 		bool vulkan_semantics = false;
@@ -99,14 +110,22 @@ public:
 		remap_pls_variables();
 	}
 
-	CompilerGLSL(std::vector<uint32_t> spirv_)
-	    : Compiler(move(spirv_))
+	CompilerGLSL(std::vector<uint32_t> spirv_, bool time_parse = false)
+	    : Compiler(move(spirv_), time_parse)
 	{
-		if (source.known)
-		{
-			options.es = source.es;
-			options.version = source.version;
-		}
+		init();
+	}
+
+	CompilerGLSL(ParsedIR ir)
+	    : Compiler(std::move(ir))
+	{
+		init();
+	}
+
+	CompilerGLSL(const uint32_t *ir, size_t word_count, bool time_parse = false)
+	    : Compiler(ir, word_count, time_parse)
+	{
+		init();
 	}
 
 	const Options &get_options() const
@@ -120,6 +139,13 @@ public:
 
 	std::string compile() override;
 
+	// Returns the number of emission passes the last call to compile() needed.
+	// Ideally 1. Anything more means emission hit something the pre-emission analysis could not predict.
+	uint32_t get_compile_pass_count() const
+	{
+		return pass_count;
+	}
+
 	// Returns the current string held in the conversion buffer. Useful for
 	// capturing what has been converted so far when compile() throws an error.
 	std::string get_partial_source();
@@ -140,10 +166,22 @@ public:
 	// require_extension("GL_KHR_my_extension");
 	void require_extension(const std::string &ext);
 
+	// Hashes every field of the options, for building cache keys without a compiler instance.
+	static void hash_options(Hasher &hasher, const Options &options);
+
 protected:
+	void hash_compile_state(Hasher &hasher) const override;
+
 	void reset();
 	void emit_function(SPIRFunction &func, uint64_t return_flags);
 
+	// Places the local variables of a function, with CFG analysis if enabled. Only does work the first time.
+	void analyze_function_variable_scope(SPIRFunction &func, CompilerStats *timing);
+
+	// Analyzes all functions reachable from the entry point on options.cfg_analysis_threads threads.
+	// Does nothing when running single-threaded, leaving emit_function to analyze functions as it goes.
+	void analyze_variable_scopes();
+
 	// Virtualize methods which need to be overridden by subclass targets like C++ and such.
 	virtual void emit_function_prototype(SPIRFunction &func, uint64_t return_flags);
 	virtual void emit_instruction(const Instruction &instr);
@@ -172,19 +210,19 @@ protected:
 	                                     bool *p_forward);
 	virtual std::string clean_func_name(std::string func_name);
 
-	std::unique_ptr<std::ostringstream> buffer;
+	StringStream<> buffer;
 
 	template <typename T>
 	inline void statement_inner(T &&t)
 	{
-		(*buffer) << std::forward<T>(t);
+		buffer << std::forward<T>(t);
 		statement_count++;
 	}
 
 	template <typename T, typename... Ts>
 	inline void statement_inner(T &&t, Ts &&... ts)
 	{
-		(*buffer) << std::forward<T>(t);
+		buffer << std::forward<T>(t);
 		statement_count++;
 		statement_inner(std::forward<Ts>(ts)...);
 	}
@@ -196,11 +234,9 @@ protected:
 			redirect_statement->push_back(join(std::forward<Ts>(ts)...));
 		else
 		{
-			for (uint32_t i = 0; i < indent; i++)
-				(*buffer) << "    ";
-
+			buffer.append(' ', indent * 4);
 			statement_inner(std::forward<Ts>(ts)...);
-			(*buffer) << '\n';
+			buffer << '\n';
 		}
 	}
 
@@ -239,8 +275,9 @@ protected:
 	bool member_is_non_native_row_major_matrix(const SPIRType &type, uint32_t index);
 	virtual std::string convert_row_major_matrix(std::string exp_str);
 
-	std::unordered_set<std::string> local_variable_names;
-	std::unordered_set<std::string> resource_names;
+	// StringInterner handles of the names in use.
+	std::unordered_set<uint32_t> local_variable_names;
+	std::unordered_set<uint32_t> resource_names;
 
 	bool processing_entry_point = false;
 
@@ -316,6 +353,7 @@ protected:
 	void append_global_func_args(const SPIRFunction &func, uint32_t index, std::vector<std::string> &arglist);
 	std::string to_expression(uint32_t id);
 	std::string to_enclosed_expression(uint32_t id);
+	static bool needs_enclose_expression(const std::string &expr);
 	void strip_enclosed_expression(std::string &expr);
 	std::string to_member_name(const SPIRType &type, uint32_t index);
 	std::string type_to_glsl_constructor(const SPIRType &type);
@@ -360,8 +398,8 @@ protected:
 	// Usage tracking. If a temporary is used more than once, use the temporary instead to
 	// avoid AST explosion when SPIRV is generated with pure SSA and doesn't write stuff to variables.
 	std::unordered_map<uint32_t, uint32_t> expression_usage_counts;
-	std::unordered_set<uint32_t> forced_temporaries;
-	std::unordered_set<uint32_t> forwarded_temporaries;
+	IDBitset forced_temporaries;
+	IDBitset forwarded_temporaries;
 	void track_expression_read(uint32_t id);
 
 	std::unordered_set<std::string> forced_extensions;
@@ -396,7 +434,7 @@ protected:
 	void emit_pls();
 	void remap_pls_variables();
 
-	void add_variable(std::unordered_set<std::string> &variables, uint32_t id);
+	void add_variable(std::unordered_set<uint32_t> &variables, uint32_t id);
 	void check_function_call_constraints(const uint32_t *args, uint32_t length);
 	void handle_invalid_expression(uint32_t id);
 	void find_static_extensions();
@@ -404,6 +442,63 @@ protected:
 	std::string emit_for_loop_initializers(const SPIRBlock &block);
 	bool optimize_read_modify_write(const std::string &lhs, const std::string &rhs);
 	void fixup_image_load_store_access();
+
+	// Finds state which emission would otherwise only discover halfway through a pass,
+	// forcing another full compilation pass: function parameters which are written to,
+	// images which are read, written or used with atomics, the extensions those need,
+	// and temporaries which are read more than once.
+	void analyze_static_access();
+	uint32_t pass_count = 0;
+
+	// Bracket each emission pass of compile() to fill in CompilerStats.
+	void begin_pass_stats();
+	void end_pass_stats();
+	std::chrono::steady_clock::time_point pass_start;
+
+	struct StaticAccessHandler : OpcodeHandler
+	{
+		StaticAccessHandler(CompilerGLSL &compiler_, uint32_t entry_point_)
+		    : compiler(compiler_)
+		{
+			function_stack.push_back(entry_point_);
+		}
+
+		bool handle(spv::Op opcode, const uint32_t *args, uint32_t length) override;
+		bool begin_function_scope(const uint32_t *args, uint32_t length) override;
+		bool end_function_scope(const uint32_t *args, uint32_t length) override;
+
+		uint32_t backing_variable(uint32_t id) const;
+		void mark_written(uint32_t id);
+		void clear_image_flags(uint32_t id, uint64_t flags);
+		void set_current_block(const SPIRBlock &block) override;
+		void count_reads(spv::Op opcode, const uint32_t *args, uint32_t length);
+		void count_reads(const uint32_t *args, uint32_t length);
+		uint32_t type_vecsize(uint32_t id) const;
+
+		CompilerGLSL &compiler;
+		std::vector<uint32_t> function_stack;
+		std::unordered_map<uint32_t, uint32_t> backing_variables;
+		std::unordered_set<uint32_t> image_texel_pointers;
+		bool image_atomics = false;
+
+		// How many times emission reads each ID through to_expression(), see track_expression_read().
+		std::unordered_map<uint32_t, uint32_t> read_counts;
+		// Results which emission forwards with usage tracking, so reading them twice forces a temporary.
+		std::unordered_set<uint32_t> usage_tracked;
+		// Results whose reads cannot be counted up front. These are left to the recompile loop.
+		std::unordered_set<uint32_t> uncounted;
+		std::unordered_map<uint32_t, uint32_t> result_types;
+	};
+
+private:
+	void init()
+	{
+		if (source.known)
+		{
+			options.es = source.es;
+			options.version = source.version;
+		}
+	}
 };
 }
 
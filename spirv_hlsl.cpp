@@ -25,14 +25,15 @@ using namespace std;
 namespace
 {
 	struct VariableComparator {
-		VariableComparator(const std::vector<Meta>& meta) : meta(meta) { }
+		VariableComparator(const std::vector<Meta>& meta, const StringInterner& n) : meta(meta), names(n) { }
 
 		bool operator () (SPIRVariable* var1, SPIRVariable* var2)
 		{
-			return meta[var1->self].decoration.alias.compare(meta[var2->self].decoration.alias) < 0;
+			return names.get(meta[var1->self].decoration.alias).compare(names.get(meta[var2->self].decoration.alias)) < 0;
 		}
 
 		const std::vector<Meta>& meta;
+		const StringInterner& names;
 	};
 }
 
@@ -191,14 +192,14 @@ void CompilerHLSL::emit_interface_block_in_struct(const SPIRVariable &var, uint3
 
 	if ((is_no_builtin && !builtins) || (!is_no_builtin && builtins))
 	{
-		auto &m = meta[var.self].decoration;
+		auto &var_name = get_name(var.self);
 		if (use_binding_number)
 		{
 			if (type.vecsize == 4 && type.columns == 4)
 			{
 				for (int i = 0; i < 4; ++i) {
 					char name[101];
-					strcpy(name, m.alias.c_str());
+					strcpy(name, var_name.c_str());
 					strcat(name, "_");
 					size_t length = strlen(name);
 					sprintf(&name[length], "%d", i);
@@ -211,7 +212,7 @@ void CompilerHLSL::emit_interface_block_in_struct(const SPIRVariable &var, uint3
 			}
 			else
 			{
-				statement(variable_decl(type, m.alias), " : ", binding, binding_number, ";");
+				statement(variable_decl(type, var_name), " : ", binding, binding_number, ";");
 			}
 		}
 		else
@@ -220,7 +221,7 @@ void CompilerHLSL::emit_interface_block_in_struct(const SPIRVariable &var, uint3
 				statement("float4 gl_Position", " : ", binding, ";");
 			}
 			else {
-				statement(variable_decl(type, m.alias), " : ", binding, ";");
+				statement(variable_decl(type, var_name), " : ", binding, ";");
 			}
 		}
 	}
@@ -332,7 +333,7 @@ void CompilerHLSL::emit_resources()
 			}
 		}
 	}
-	sort(variables.begin(), variables.end(), VariableComparator(meta));
+	sort(variables.begin(), variables.end(), VariableComparator(meta, names));
 	for (auto var : variables)
 	{
 		emit_interface_block_in_struct(*var, binding_number, false);
@@ -369,7 +370,7 @@ void CompilerHLSL::emit_resources()
 			}
 		}
 	}
-	sort(variables.begin(), variables.end(), VariableComparator(meta));
+	sort(variables.begin(), variables.end(), VariableComparator(meta, names));
 	for (auto var : variables)
 	{
 		emit_interface_block_in_struct(*var, binding_number, false);
@@ -481,18 +482,18 @@ void CompilerHLSL::emit_hlsl_entry_point()
 			{
 				if (execution.model == ExecutionModelVertex && is_builtin_variable(var)) continue;
 
-				auto &m = meta[var.self].decoration;
+				auto &var_name = get_name(var.self);
 				auto &type = get<SPIRType>(var.basetype);
 				if (type.vecsize == 4 && type.columns == 4)
 				{
-					statement(m.alias, "[0] = input.", m.alias, "_0;");
-					statement(m.alias, "[1] = input.", m.alias, "_1;");
-					statement(m.alias, "[2] = input.", m.alias, "_2;");
-					statement(m.alias, "[3] = input.", m.alias, "_3;");
+					statement(var_name, "[0] = input.", var_name, "_0;");
+					statement(var_name, "[1] = input.", var_name, "_1;");
+					statement(var_name, "[2] = input.", var_name, "_2;");
+					statement(var_name, "[3] = input.", var_name, "_3;");
 				}
 				else
 				{
-					statement(m.alias, " = input.", m.alias, ";");
+					statement(var_name, " = input.", var_name, ";");
 				}
 			}
 		}
@@ -519,9 +520,9 @@ void CompilerHLSL::emit_hlsl_entry_point()
 			if (var.storage != StorageClassFunction && !var.remapped_variable && type.pointer &&
 			    var.storage == StorageClassOutput && interface_variable_exists_in_entry_point(var.self))
 			{
-				auto &m = meta[var.self].decoration;
+				auto &var_name = get_name(var.self);
 				bool is_no_builtin = !is_builtin_variable(var) && !var.remapped_variable;
-				if (is_no_builtin) statement("output.", m.alias, " = ", m.alias, ";");
+				if (is_no_builtin) statement("output.", var_name, " = ", var_name, ";");
 				else if (execution.model == ExecutionModelVertex) {
 					statement("output.gl_Position = gl_Position;");
 				}
@@ -550,7 +551,7 @@ void CompilerHLSL::emit_texture_op(const Instruction &i)
 	auto op = static_cast<Op>(i.op);
 	uint32_t length = i.length;
 
-	if (i.offset + length > spirv.size())
+	if (i.offset + length > spirv_word_count)
 		throw CompilerError("Compiler::parse() opcode out of range.");
 
 	uint32_t result_type = ops[0];
@@ -819,7 +820,7 @@ void CompilerHLSL::emit_binary_func_op_transpose_first(uint32_t result_type, uin
 	bool forward = should_forward(op0) && should_forward(op1);
 	emit_op(result_type, result_id, join(op, "(transpose(", to_expression(op0), "), ", to_expression(op1), ")"), forward, false);
 
-	if (forward && forced_temporaries.find(result_id) == end(forced_temporaries))
+	if (forward && !forced_temporaries.count(result_id))
 	{
 		inherit_expression_dependencies(result_id, op0);
 		inherit_expression_dependencies(result_id, op1);
@@ -832,7 +833,7 @@ void CompilerHLSL::emit_binary_func_op_transpose_second(uint32_t result_type, ui
 	bool forward = should_forward(op0) && should_forward(op1);
 	emit_op(result_type, result_id, join(op, "(", to_expression(op0), ", transpose(", to_expression(op1), "))"), forward, false);
 
-	if (forward && forced_temporaries.find(result_id) == end(forced_temporaries))
+	if (forward && !forced_temporaries.count(result_id))
 	{
 		inherit_expression_dependencies(result_id, op0);
 		inherit_expression_dependencies(result_id, op1);
@@ -845,7 +846,7 @@ void CompilerHLSL::emit_binary_func_op_transpose_all(uint32_t result_type, uint3
 	bool forward = should_forward(op0) && should_forward(op1);
 	emit_op(result_type, result_id, join("transpose(", op, "(transpose(", to_expression(op0), "), transpose(", to_expression(op1), ")))"), forward, false);
 
-	if (forward && forced_temporaries.find(result_id) == end(forced_temporaries))
+	if (forward && !forced_temporaries.count(result_id))
 	{
 		inherit_expression_dependencies(result_id, op0);
 		inherit_expression_dependencies(result_id, op1);
@@ -930,6 +931,13 @@ void CompilerHLSL::emit_instruction(const Instruction &instruction)
 	}
 }
 
+void CompilerHLSL::hash_compile_state(Hasher &hasher) const
+{
+	CompilerGLSL::hash_compile_state(hasher);
+	hasher.string("hlsl");
+	hasher.u32(options.shader_model);
+}
+
 string CompilerHLSL::compile()
 {
 	// Do not deal with ES-isms like precision, older extensions and such.
@@ -948,7 +956,9 @@ string CompilerHLSL::compile()
 	backend.use_initializer_list = true;
 	backend.use_constructor_splatting = false;
 
-	uint32_t pass_count = 0;
+	analyze_static_access();
+
+	pass_count = 0;
 	do
 	{
 		if (pass_count >= 3)
@@ -956,17 +966,19 @@ string CompilerHLSL::compile()
 
 		reset();
 
-		// Move constructor for this type is broken on GCC 4.9 ...
-		buffer = unique_ptr<ostringstream>(new ostringstream());
+		buffer.reset();
+		begin_pass_stats();
 
 		emit_header();
 		emit_resources();
 
+		analyze_variable_scopes();
 		emit_function(get<SPIRFunction>(entry_point), 0);
 		emit_hlsl_entry_point();
 
+		end_pass_stats();
 		pass_count++;
 	} while (force_recompile);
 
-	return buffer->str();
+	return buffer.release();
 }
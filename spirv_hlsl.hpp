@@ -31,8 +31,18 @@ public:
 		uint32_t shader_model = 30; // TODO: map ps_4_0_level_9_0,... somehow
 	};
 
-	CompilerHLSL(std::vector<uint32_t> spirv_)
-	    : CompilerGLSL(move(spirv_))
+	CompilerHLSL(std::vector<uint32_t> spirv_, bool time_parse = false)
+	    : CompilerGLSL(move(spirv_), time_parse)
+	{
+	}
+
+	CompilerHLSL(ParsedIR ir)
+	    : CompilerGLSL(std::move(ir))
+	{
+	}
+
+	CompilerHLSL(const uint32_t *ir, size_t word_count, bool time_parse = false)
+	    : CompilerGLSL(ir, word_count, time_parse)
 	{
 	}
 
@@ -49,6 +59,7 @@ public:
 	std::string compile() override;
 
 private:
+	void hash_compile_state(Hasher &hasher) const override;
 	std::string type_to_glsl(const SPIRType &type) override;
 	void emit_function_prototype(SPIRFunction &func, uint64_t return_flags) override;
 	void emit_hlsl_entry_point();
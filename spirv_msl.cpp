@@ -25,8 +25,24 @@ using namespace spv;
 using namespace spirv_cross;
 using namespace std;
 
-CompilerMSL::CompilerMSL(vector<uint32_t> spirv_)
-    : CompilerGLSL(move(spirv_))
+CompilerMSL::CompilerMSL(vector<uint32_t> spirv_, bool time_parse)
+    : CompilerGLSL(move(spirv_), time_parse)
+{
+	options.vertex.fixup_clipspace = false;
+
+	populate_func_name_overrides();
+}
+
+CompilerMSL::CompilerMSL(const uint32_t *ir, size_t word_count, bool time_parse)
+    : CompilerGLSL(ir, word_count, time_parse)
+{
+	options.vertex.fixup_clipspace = false;
+
+	populate_func_name_overrides();
+}
+
+CompilerMSL::CompilerMSL(ParsedIR ir)
+    : CompilerGLSL(move(ir))
 {
 	options.vertex.fixup_clipspace = false;
 
@@ -40,11 +56,99 @@ void CompilerMSL::populate_func_name_overrides()
 	func_name_overrides["saturate"] = "saturate0";
 }
 
+MSLResourceBindingTable::MSLResourceBindingTable(vector<MSLResourceBinding> bindings_)
+{
+	bindings.reserve(bindings_.size());
+	for (auto &binding : bindings_)
+		add(binding);
+}
+
+void MSLResourceBindingTable::add(const MSLResourceBinding &binding)
+{
+	Key key = { binding.stage, binding.desc_set, binding.binding };
+	binding_indices.emplace(key, uint32_t(bindings.size()));
+	bindings.push_back(binding);
+}
+
+MSLResourceBinding *MSLResourceBindingTable::find(ExecutionModel stage, uint32_t desc_set, uint32_t binding)
+{
+	Key key = { stage, desc_set, binding };
+	auto itr = binding_indices.find(key);
+	return itr != end(binding_indices) ? &bindings[itr->second] : nullptr;
+}
+
+vector<uint32_t> MSLResourceBindingTable::get_unused_bindings() const
+{
+	vector<uint32_t> unused;
+	for (uint32_t i = 0; i < uint32_t(bindings.size()); i++)
+		if (!bindings[i].used_by_shader)
+			unused.push_back(i);
+	return unused;
+}
+
+void MSLResourceBindingTable::reset_usage()
+{
+	for (auto &binding : bindings)
+		binding.used_by_shader = false;
+}
+
 string CompilerMSL::compile(MSLConfiguration &msl_cfg, vector<MSLVertexAttr> *p_vtx_attrs,
                             std::vector<MSLResourceBinding> *p_res_bindings)
 {
-	// Force a classic "C" locale, reverts when function returns
-	ClassicLocale classic_locale;
+	if (!p_res_bindings)
+	{
+		MSLResourceBindingTable no_bindings;
+		return compile(msl_cfg, p_vtx_attrs, no_bindings);
+	}
+
+	// Report used bindings back in the caller's list.
+	MSLResourceBindingTable table(*p_res_bindings);
+	auto msl = compile(msl_cfg, p_vtx_attrs, table);
+	for (size_t i = 0; i < p_res_bindings->size(); i++)
+		(*p_res_bindings)[i].used_by_shader = table.get_bindings()[i].used_by_shader;
+	return msl;
+}
+
+string CompilerMSL::compile(MSLConfiguration &msl_cfg, vector<MSLVertexAttr> *p_vtx_attrs,
+                            MSLResourceBindingTable &res_bindings)
+{
+	// Lowering to MSL adds interface blocks and turns global variables into function parameters,
+	// so a second compile() would start from the lowered module.
+	if (module_lowered)
+		SPIRV_CROSS_THROW("The module was already compiled. Call set_repeatable_compile() to compile it again.");
+
+	// With set_repeatable_compile(), put the IR back as it was once we are done, so the same module can be compiled
+	// again, e.g. with other configurations or resource bindings, without parsing it again.
+	struct IRRestorer
+	{
+		CompilerMSL &compiler;
+
+		~IRRestorer()
+		{
+			if (compiler.lowering_undo.active)
+				compiler.undo_lowering();
+			else
+				compiler.module_lowered = true;
+
+			// These may point into IR which was just dropped.
+			compiler.current_function = nullptr;
+			compiler.current_block = nullptr;
+
+			// These point into the caller's vertex attributes and binding table, which may go away after compile().
+			compiler.vtx_attrs_by_location.clear();
+			compiler.resource_bindings = nullptr;
+		}
+	} restorer{ *this };
+
+	if (repeatable_compile)
+	{
+		lowering_undo.active = true;
+		lowering_undo.id_bound = uint32_t(ids.size());
+	}
+
+	// Temporaries forced by a previous compile may refer to IDs which only existed for that configuration.
+	forced_temporaries.clear();
+	function_global_vars.clear();
 
 	// Remember the input parameters
 	msl_config = msl_cfg;
@@ -54,10 +158,7 @@ string CompilerMSL::compile(MSLConfiguration &msl_cfg, vector<MSLVertexAttr> *p_
 		for (auto &va : *p_vtx_attrs)
 			vtx_attrs_by_location[va.location] = &va;
 
-	resource_bindings.clear();
-	if (p_res_bindings)
-		for (auto &rb : *p_res_bindings)
-			resource_bindings.push_back(&rb);
+	resource_bindings = &res_bindings;
 
 	// Establish the need to output any custom functions
 	set_enabled_interface_variables(get_active_interface_variables());
@@ -85,7 +186,9 @@ string CompilerMSL::compile(MSLConfiguration &msl_cfg, vector<MSLVertexAttr> *p_
 	backend.shared_is_implied = false;
 	backend.native_row_major_matrix = false;
 
-	uint32_t pass_count = 0;
+	analyze_static_access();
+
+	pass_count = 0;
 	do
 	{
 		if (pass_count >= 3)
@@ -95,19 +198,21 @@ string CompilerMSL::compile(MSLConfiguration &msl_cfg, vector<MSLVertexAttr> *p_
 
 		next_metal_resource_index = MSLResourceBinding(); // Start bindings at zero
 
-		// Move constructor for this type is broken on GCC 4.9 ...
-		buffer = unique_ptr<ostringstream>(new ostringstream());
+		buffer.reset();
+		begin_pass_stats();
 
 		emit_header();
 		emit_resources();
 		emit_custom_functions();
 		emit_function_declarations();
+		analyze_variable_scopes();
 		emit_function(get<SPIRFunction>(entry_point), 0);
 
+		end_pass_stats();
 		pass_count++;
 	} while (force_recompile);
 
-	return buffer->str();
+	return buffer.release();
 }
 
 string CompilerMSL::compile()
@@ -116,6 +221,47 @@ string CompilerMSL::compile()
 	return compile(default_msl_cfg, nullptr, nullptr);
 }
 
+// Lowering only records state of IDs which existed before compile(), anything newer is dropped as a whole.
+void CompilerMSL::save_meta(uint32_t id)
+{
+	if (lowering_undo.active && id < lowering_undo.id_bound)
+		lowering_undo.meta.emplace(id, meta[id]);
+}
+
+void CompilerMSL::save_function(const SPIRFunction &func)
+{
+	if (lowering_undo.active)
+	{
+		lowering_undo.argument_counts.emplace(func.self, func.arguments.size());
+		lowering_undo.local_variable_counts.emplace(func.self, func.local_variables.size());
+	}
+}
+
+void CompilerMSL::save_return_value(const SPIRBlock &block)
+{
+	if (lowering_undo.active)
+		lowering_undo.return_values.emplace(block.self, block.return_value);
+}
+
+void CompilerMSL::undo_lowering()
+{
+	auto &undo = lowering_undo;
+
+	for (auto &saved : undo.meta)
+		meta[saved.first] = saved.second;
+	for (auto &count : undo.argument_counts)
+		get<SPIRFunction>(count.first).arguments.resize(count.second);
+	for (auto &count : undo.local_variable_counts)
+		get<SPIRFunction>(count.first).local_variables.resize(count.second);
+	for (auto &value : undo.return_values)
+		get<SPIRBlock>(value.first).return_value = value.second;
+
+	ids.erase(begin(ids) + undo.id_bound, end(ids));
+	meta.resize(undo.id_bound);
+
+	undo = LoweringUndo();
+}
+
 // Register the need to output any custom functions.
 void CompilerMSL::register_custom_functions()
 {
@@ -129,6 +275,7 @@ void CompilerMSL::register_custom_functions()
 void CompilerMSL::localize_global_variables()
 {
 	auto &entry_func = get<SPIRFunction>(entry_point);
+	save_function(entry_func);
 	auto iter = global_variables.begin();
 	while (iter != global_variables.end())
 	{
@@ -234,6 +381,7 @@ void CompilerMSL::extract_global_variables_from_function(uint32_t func_id, std::
 	if (func_id != entry_point)
 	{
 		uint32_t next_id = increase_bound_by(uint32_t(added_arg_ids.size()));
+		save_function(func);
 		for (uint32_t arg_id : added_arg_ids)
 		{
 			uint32_t type_id = get<SPIRVariable>(arg_id).basetype;
@@ -242,6 +390,7 @@ void CompilerMSL::extract_global_variables_from_function(uint32_t func_id, std::
 
 			// Ensure both the existing and new variables have the same name, and the name is valid
 			string vld_name = ensure_valid_name(to_name(arg_id), "v");
+			save_meta(arg_id);
 			set_name(arg_id, vld_name);
 			set_name(next_id, vld_name);
 
@@ -254,11 +403,13 @@ void CompilerMSL::extract_global_variables_from_function(uint32_t func_id, std::
 // If a vertex attribute exists at the location, it is marked as being used by this shader
 void CompilerMSL::mark_location_as_used_by_shader(uint32_t location, StorageClass storage)
 {
-	MSLVertexAttr *p_va;
 	auto &execution = get_entry_point();
-	if ((execution.model == ExecutionModelVertex) && (storage == StorageClassInput) &&
-	    (p_va = vtx_attrs_by_location[location]))
-		p_va->used_by_shader = true;
+	if ((execution.model == ExecutionModelVertex) && (storage == StorageClassInput))
+	{
+		auto itr = vtx_attrs_by_location.find(location);
+		if (itr != end(vtx_attrs_by_location))
+			itr->second->used_by_shader = true;
+	}
 }
 
 // Add an interface structure for the type of storage, which is either StorageClassInput or StorageClassOutput.
@@ -315,12 +466,16 @@ uint32_t CompilerMSL::add_interface_block(StorageClass storage)
 		// and force the entry function to return the output interface struct from
 		// any blocks that perform a function return.
 		auto &entry_func = get<SPIRFunction>(entry_point);
+		save_function(entry_func);
 		entry_func.add_local_variable(ib_var_id);
 		for (auto &blk_id : entry_func.blocks)
 		{
 			auto &blk = get<SPIRBlock>(blk_id);
 			if (blk.terminator == SPIRBlock::Return)
+			{
+				save_return_value(blk);
 				blk.return_value = ib_var_id;
+			}
 		}
 		break;
 	}
@@ -357,6 +512,7 @@ uint32_t CompilerMSL::add_interface_block(StorageClass storage)
 
 				// Update the original variable reference to include the structure reference
 				string qual_var_name = ib_var_ref + "." + mbr_name;
+				save_meta(type_id);
 				set_member_qualified_name(type_id, mbr_idx, qual_var_name);
 
 				// Copy the variable location from the original variable to the member
@@ -392,7 +548,8 @@ uint32_t CompilerMSL::add_interface_block(StorageClass storage)
 
 			// Update the original variable reference to include the structure reference
 			string qual_var_name = ib_var_ref + "." + mbr_name;
-			meta[p_var->self].decoration.qualified_alias = qual_var_name;
+			save_meta(p_var->self);
+			meta[p_var->self].decoration.qualified_alias = names.intern(qual_var_name);
 
 			// Copy the variable location from the original variable to the member
 			auto &dec = meta[p_var->self].decoration;
@@ -419,7 +576,7 @@ uint32_t CompilerMSL::add_interface_block(StorageClass storage)
 	// particularly if the offsets are all equal.
 	MemberSorter::SortAspect sort_aspect =
 	    (storage == StorageClassInput) ? MemberSorter::LocationReverse : MemberSorter::Location;
-	MemberSorter memberSorter(ib_type, meta[ib_type_id], sort_aspect);
+	MemberSorter memberSorter(ib_type, meta[ib_type_id], names, sort_aspect);
 	memberSorter.sort();
 
 	// Sort input or output variables alphabetical
@@ -427,7 +584,7 @@ uint32_t CompilerMSL::add_interface_block(StorageClass storage)
 	if ((execution.model == ExecutionModelFragment && storage == StorageClassInput) ||
 	    (execution.model == ExecutionModelVertex && storage == StorageClassOutput))
 	{
-		MemberSorter memberSorter(ib_type, meta[ib_type.self], MemberSorter::Alphabetical);
+		MemberSorter memberSorter(ib_type, meta[ib_type.self], names, MemberSorter::Alphabetical);
 		memberSorter.sort();
 	}
 
@@ -674,11 +831,13 @@ void CompilerMSL::emit_function_declarations()
 			if (func.self != entry_point)
 			{
 				auto &dec = meta[func.self].decoration;
-				if (dec.alias[0] != 'm')
+				auto &name = names.get(dec.alias);
+				if (name[0] != 'm')
 				{
 					// Add prefix to all fuctions in order to avoid ambiguous function names (e.g. builtin functions)
 					// TODO: check if current function is a builtin function
-					dec.alias = join("m", dec.alias);
+					save_meta(func.self);
+					dec.alias = names.intern(join("m", name));
 				}
 				emit_function_prototype(func, true);
 			}
@@ -1269,11 +1428,17 @@ string CompilerMSL::clean_func_name(string func_name)
 	return (iter != func_name_overrides.end()) ? iter->second : func_name;
 }
 
+void CompilerMSL::hash_compile_state(Hasher &hasher) const
+{
+	CompilerGLSL::hash_compile_state(hasher);
+	hasher.string("msl");
+}
+
 void CompilerMSL::set_entry_point_name(string func_name)
 {
 	if (func_name.find("main") == std::string::npos)
 		func_name += "_main";
-	meta.at(entry_point).decoration.alias = func_name;
+	meta.at(entry_point).decoration.alias = names.intern(func_name);
 }
 
 // Returns a string containing a comma-delimited list of args for the entry point function
@@ -1367,24 +1532,20 @@ uint32_t CompilerMSL::get_metal_resource_index(SPIRVariable &var, SPIRType::Base
 	uint32_t var_binding = (var.storage == StorageClassPushConstant) ? kPushConstBinding : var_dec.binding;
 
 	// If a matching binding has been specified, find and use it
-	for (auto p_res_bind : resource_bindings)
+	auto *p_res_bind = resource_bindings->find(execution.model, var_desc_set, var_binding);
+	if (p_res_bind)
 	{
-		if (p_res_bind->stage == execution.model && p_res_bind->desc_set == var_desc_set &&
-		    p_res_bind->binding == var_binding)
+		p_res_bind->used_by_shader = true;
+		switch (basetype)
 		{
-
-			p_res_bind->used_by_shader = true;
-			switch (basetype)
-			{
-			case SPIRType::Struct:
-				return p_res_bind->msl_buffer;
-			case SPIRType::Image:
-				return p_res_bind->msl_texture;
-			case SPIRType::Sampler:
-				return p_res_bind->msl_sampler;
-			default:
-				return 0;
-			}
+		case SPIRType::Struct:
+			return p_res_bind->msl_buffer;
+		case SPIRType::Image:
+			return p_res_bind->msl_texture;
+		case SPIRType::Sampler:
+			return p_res_bind->msl_sampler;
+		default:
+			return 0;
 		}
 	}
 
@@ -1429,7 +1590,7 @@ string CompilerMSL::to_name(uint32_t id, bool allow_alias)
 {
 	if (current_function && (current_function->self == entry_point))
 	{
-		string qual_name = meta.at(id).decoration.qualified_alias;
+		auto &qual_name = names.get(meta.at(id).decoration.qualified_alias);
 		if (!qual_name.empty())
 			return qual_name;
 	}
@@ -1852,7 +2013,7 @@ bool CompilerMSL::MemberSorter::operator()(uint32_t mbr_idx1, uint32_t mbr_idx2)
 			return (mbr_meta1.offset < mbr_meta2.offset) ||
 			       ((mbr_meta1.offset == mbr_meta2.offset) && (mbr_meta1.location > mbr_meta2.location));
 		case Alphabetical:
-			return mbr_meta1.alias > mbr_meta2.alias;
+			return names.get(mbr_meta1.alias) > names.get(mbr_meta2.alias);
 		default:
 			return false;
 		}
@@ -70,12 +70,74 @@ static const uint32_t kPushConstDescSet = UINT32_MAX;
 // element to indicate the bindings for the push constants.
 static const uint32_t kPushConstBinding = 0;
 
+// A list of resource bindings, indexed by stage, desc_set and binding.
+// Build it once for all the bindings of a pipeline, or a whole pipeline library,
+// and pass it to the compile() of every shader and stage which uses them.
+// As with a plain list, when several bindings match, the one added first is used.
+// compile() sets used_by_shader flags in the table, so a table must not be used by concurrent compiles.
+// Give each thread its own copy instead.
+class MSLResourceBindingTable
+{
+public:
+	MSLResourceBindingTable() = default;
+	explicit MSLResourceBindingTable(std::vector<MSLResourceBinding> bindings);
+
+	void add(const MSLResourceBinding &binding);
+
+	// Returns nullptr if there is no matching binding.
+	MSLResourceBinding *find(spv::ExecutionModel stage, uint32_t desc_set, uint32_t binding);
+
+	// The bindings in the order they were added, including the used_by_shader flags set by compile().
+	const std::vector<MSLResourceBinding> &get_bindings() const
+	{
+		return bindings;
+	}
+
+	// Indices into get_bindings() of every binding which no compile() has used since the table was built,
+	// or since the last reset_usage().
+	std::vector<uint32_t> get_unused_bindings() const;
+
+	// Clears used_by_shader on all bindings.
+	void reset_usage();
+
+private:
+	struct Key
+	{
+		spv::ExecutionModel stage;
+		uint32_t desc_set;
+		uint32_t binding;
+
+		bool operator==(const Key &other) const
+		{
+			return stage == other.stage && desc_set == other.desc_set && binding == other.binding;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key &key) const
+		{
+			uint64_t h = (uint64_t(key.desc_set) << 32) | key.binding;
+			return std::hash<uint64_t>()(h * 0x9e3779b97f4a7c15ull + uint64_t(key.stage));
+		}
+	};
+
+	std::vector<MSLResourceBinding> bindings;
+	std::unordered_map<Key, uint32_t, KeyHash> binding_indices;
+};
+
 // Decompiles SPIR-V to Metal Shading Language
 class CompilerMSL : public CompilerGLSL
 {
 public:
 	// Constructs an instance to compile the SPIR-V code into Metal Shading Language.
-	CompilerMSL(std::vector<uint32_t> spirv);
+	CompilerMSL(std::vector<uint32_t> spirv, bool time_parse = false);
+
+	// Constructs an instance over caller-owned SPIR-V memory. See Compiler for lifetime rules.
+	CompilerMSL(const uint32_t *ir, size_t word_count, bool time_parse = false);
+
+	// Constructs an instance from an already parsed module.
+	CompilerMSL(ParsedIR ir);
 
 	// Compiles the SPIR-V code into Metal Shading Language using the specified configuration parameters.
 	//  - msl_cfg indicates some general configuration for directing the compilation.
@@ -87,15 +149,34 @@ public:
 	//    texture or sampler index to use for a particular SPIR-V description set
 	//    and binding. If resource bindings are provided, the compiler will set the
 	//    used_by_shader flag to true in any resource binding actually used by the MSL code.
+	// Lowering to MSL rewrites the module, so compile() can only be called once,
+	// unless set_repeatable_compile() was enabled before the first call.
+	// Otherwise a second call throws. Earlier versions let it through and compiled the already lowered module.
 	std::string compile(MSLConfiguration &msl_cfg, std::vector<MSLVertexAttr> *p_vtx_attrs = nullptr,
 	                    std::vector<MSLResourceBinding> *p_res_bindings = nullptr);
 
+	// Same as above, but looks resources up in a prebuilt table, which can be reused by many compiles,
+	// as long as they do not run at the same time. Bindings used by this shader get their used_by_shader flag
+	// set in the table. The compiler does not keep a reference to the table once compile() returns.
+	std::string compile(MSLConfiguration &msl_cfg, std::vector<MSLVertexAttr> *p_vtx_attrs,
+	                    MSLResourceBindingTable &res_bindings);
+
 	// Compiles the SPIR-V code into Metal Shading Language using default configuration parameters.
 	std::string compile() override;
 
 	void set_entry_point_name(std::string func_name);
 
+	// Makes compile() record the changes it makes to the module and undo them once it is done, so the module
+	// can be compiled any number of times, with the same or different parameters.
+	void set_repeatable_compile(bool repeatable)
+	{
+		repeatable_compile = repeatable;
+	}
+
 protected:
+	// The MSL configuration is passed to compile() instead of being stored up front,
+	// so callers caching MSL output must hash it themselves.
+	void hash_compile_state(Hasher &hasher) const override;
 	void emit_instruction(const Instruction &instr) override;
 	void emit_glsl_op(uint32_t result_type, uint32_t result_id, uint32_t op, const uint32_t *args,
 	                  uint32_t count) override;
@@ -158,7 +239,7 @@ protected:
 	std::unordered_map<std::string, std::string> func_name_overrides;
 	std::set<uint32_t> custom_function_ops;
 	std::unordered_map<uint32_t, MSLVertexAttr *> vtx_attrs_by_location;
-	std::vector<MSLResourceBinding *> resource_bindings;
+	MSLResourceBindingTable *resource_bindings = nullptr;
 	MSLResourceBinding next_metal_resource_index;
 	uint32_t stage_in_var_id = 0;
 	uint32_t stage_out_var_id = 0;
@@ -168,6 +249,29 @@ protected:
 	std::string stage_out_var_name = "out";
 	std::string stage_uniform_var_name = "uniforms";
 	std::string sampler_name_suffix = "Smplr";
+	bool repeatable_compile = false;
+	bool module_lowered = false;
+
+	// With set_repeatable_compile(), what lowering changed in the module, so that compile() can undo it.
+	struct LoweringUndo
+	{
+		bool active = false;
+		// IDs from this bound on were added by lowering.
+		uint32_t id_bound = 0;
+		// Original metadata of existing IDs which were renamed or given qualified names.
+		std::unordered_map<uint32_t, Meta> meta;
+		// Original lengths of the parameter and local variable lists of functions which had entries added.
+		std::unordered_map<uint32_t, size_t> argument_counts;
+		std::unordered_map<uint32_t, size_t> local_variable_counts;
+		// Original return values of blocks which now return the stage output struct.
+		std::unordered_map<uint32_t, uint32_t> return_values;
+	};
+	LoweringUndo lowering_undo;
+
+	void save_meta(uint32_t id);
+	void save_function(const SPIRFunction &func);
+	void save_return_value(const SPIRBlock &block);
+	void undo_lowering();
 	std::vector<std::string> reserved_names = { "kernel", "bias" };
 
 	// Extracts a set of opcodes that should be implemented as a bespoke custom function
@@ -202,14 +306,16 @@ protected:
 
 		void sort();
 		bool operator()(uint32_t mbr_idx1, uint32_t mbr_idx2);
-		MemberSorter(SPIRType &t, Meta &m, SortAspect sa)
+		MemberSorter(SPIRType &t, Meta &m, const StringInterner &n, SortAspect sa)
 		    : type(t)
 		    , meta(m)
+		    , names(n)
 		    , sort_aspect(sa)
 		{
 		}
 		SPIRType &type;
 		Meta &meta;
+		const StringInterner &names;
 		SortAspect sort_aspect;
 	};
 };
@@ -0,0 +1,384 @@
+/*
+ * Copyright 2015-2016 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the CFG queries (dominators, reverse post-order, dominance frontiers and walk_from)
+// against brute force answers on a hand-written loop and on randomly generated control flow.
+
+#include "spirv_cfg.hpp"
+#include "spirv_cross.hpp"
+#include <cstdio>
+#include <map>
+#include <random>
+#include <set>
+
+using namespace spv;
+using namespace spirv_cross;
+using namespace std;
+
+namespace
+{
+// Compiler has a set<T>() member, so spell the container out.
+typedef std::set<uint32_t> BlockSet;
+
+enum
+{
+	TypeVoidId = 1,
+	TypeBoolId = 2,
+	TypeFunctionId = 3,
+	ConstantTrueId = 4,
+	MainId = 5,
+	FirstLabelId = 10
+};
+
+struct Branch
+{
+	// One target is an OpBranch, two an OpBranchConditional and none an OpReturn.
+	vector<uint32_t> targets;
+};
+
+class ModuleBuilder
+{
+public:
+	void op(Op opcode, const vector<uint32_t> &args)
+	{
+		words.push_back(uint32_t(args.size() + 1) << 16 | opcode);
+		words.insert(end(words), begin(args), end(args));
+	}
+
+	// A compute shader whose entry point has one block per branch, labelled FirstLabelId + index.
+	static vector<uint32_t> build(const vector<Branch> &branches)
+	{
+		ModuleBuilder b;
+		b.words = { MagicNumber, 0x10000, 0, uint32_t(FirstLabelId + branches.size()), 0 };
+		b.op(OpCapability, { CapabilityShader });
+		b.op(OpMemoryModel, { AddressingModelLogical, MemoryModelGLSL450 });
+		b.op(OpEntryPoint, { ExecutionModelGLCompute, MainId, 0x6e69616d, 0 });
+		b.op(OpExecutionMode, { MainId, ExecutionModeLocalSize, 1, 1, 1 });
+		b.op(OpTypeVoid, { TypeVoidId });
+		b.op(OpTypeBool, { TypeBoolId });
+		b.op(OpTypeFunction, { TypeFunctionId, TypeVoidId });
+		b.op(OpConstantTrue, { TypeBoolId, ConstantTrueId });
+		b.op(OpFunction, { TypeVoidId, MainId, FunctionControlMaskNone, TypeFunctionId });
+		for (uint32_t i = 0; i < uint32_t(branches.size()); i++)
+		{
+			b.op(OpLabel, { FirstLabelId + i });
+			auto &targets = branches[i].targets;
+			if (targets.empty())
+				b.op(OpReturn, {});
+			else if (targets.size() == 1)
+				b.op(OpBranch, { FirstLabelId + targets[0] });
+			else
+				b.op(OpBranchConditional, { ConstantTrueId, FirstLabelId + targets[0], FirstLabelId + targets[1] });
+		}
+		b.op(OpFunctionEnd, {});
+		return b.words;
+	}
+
+private:
+	vector<uint32_t> words;
+};
+
+class CFGTester : public Compiler
+{
+public:
+	explicit CFGTester(vector<uint32_t> spirv_)
+	    : Compiler(move(spirv_))
+	{
+	}
+
+	// Returns the number of failed checks.
+	uint32_t run(const char *name, const map<uint32_t, BlockSet> &expected_frontiers = {});
+
+	bool is_reducible() const
+	{
+		return reducible;
+	}
+
+private:
+	uint32_t failures = 0;
+	bool reducible = true;
+	const char *test_name = nullptr;
+
+	void check(bool condition, const char *what, uint32_t a, uint32_t b = 0)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "%s: %s (%u, %u)\n", test_name, what, a, b);
+			failures++;
+		}
+	}
+
+	BlockSet get_branch_targets(uint32_t block_id)
+	{
+		auto &block = get<SPIRBlock>(block_id);
+		BlockSet targets;
+		if (block.terminator == SPIRBlock::Direct)
+			targets.insert(block.next_block);
+		else if (block.terminator == SPIRBlock::Select)
+		{
+			targets.insert(block.true_block);
+			targets.insert(block.false_block);
+		}
+		return targets;
+	}
+};
+
+uint32_t CFGTester::run(const char *name, const map<uint32_t, BlockSet> &expected_frontiers)
+{
+	test_name = name;
+	auto &func = get<SPIRFunction>(MainId);
+	CFG cfg(*this, func);
+
+	// Every edge of the function, back edges included.
+	map<uint32_t, BlockSet> succs, preds;
+	for (auto block : func.blocks)
+	{
+		succs[block] = get_branch_targets(block);
+		for (auto target : succs[block])
+			preds[target].insert(block);
+	}
+
+	const auto reachable_from = [](uint32_t start, const map<uint32_t, BlockSet> &edges) {
+		BlockSet seen;
+		vector<uint32_t> stack = { start };
+		while (!stack.empty())
+		{
+			uint32_t block = stack.back();
+			stack.pop_back();
+			if (seen.insert(block).second)
+				for (auto next : edges.at(block))
+					stack.push_back(next);
+		}
+		return seen;
+	};
+	auto reachable = reachable_from(func.entry_block, succs);
+
+	// Iterative dominator sets.
+	map<uint32_t, BlockSet> dom;
+	for (auto block : reachable)
+		dom[block] = block == func.entry_block ? BlockSet{ block } : reachable;
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		for (auto block : reachable)
+		{
+			if (block == func.entry_block)
+				continue;
+
+			BlockSet next = reachable;
+			for (auto pred : preds[block])
+			{
+				if (!reachable.count(pred))
+					continue;
+				BlockSet both;
+				for (auto d : next)
+					if (dom[pred].count(d))
+						both.insert(d);
+				next = both;
+			}
+			next.insert(block);
+			if (next != dom[block])
+			{
+				dom[block] = next;
+				changed = true;
+			}
+		}
+	}
+
+	const auto dominates = [&](uint32_t a, uint32_t b) { return reachable.count(b) && dom[b].count(a) != 0; };
+
+	// Edges the CFG leaves out are retreating edges of its depth-first search. CFG expects structured control flow,
+	// where they all branch back to a loop header dominating them. Random control flow which is not reducible is skipped.
+	for (auto block : reachable)
+	{
+		BlockSet recorded;
+		for (auto next : cfg.get_succeeding_edges(block))
+			recorded.insert(next);
+		for (auto next : succs[block])
+			if (!recorded.count(next) && !dominates(next, block))
+			{
+				reducible = false;
+				return 0;
+			}
+	}
+
+	for (auto a : func.blocks)
+	{
+		for (auto b : func.blocks)
+			check(cfg.dominates(a, b) == (reachable.count(a) && dominates(a, b)), "dominates", a, b);
+
+		uint32_t idom = 0;
+		if (a == func.entry_block)
+			idom = a;
+		else if (reachable.count(a))
+		{
+			for (auto d : dom[a])
+				if (d != a && (!idom || dom[d].size() > dom[idom].size()))
+					idom = d;
+		}
+		check(cfg.get_immediate_dominator(a) == idom, "immediate dominator", a, idom);
+	}
+
+	for (auto a : reachable)
+	{
+		for (auto b : reachable)
+		{
+			uint32_t common = 0;
+			for (auto d : dom[a])
+				if (dom[b].count(d) && (!common || dom[d].size() > dom[common].size()))
+					common = d;
+			check(cfg.find_common_dominator(a, b) == common, "common dominator", a, b);
+		}
+	}
+
+	// Recorded edges are the real edges minus back edges, which lead to blocks finishing no earlier in post-order.
+	map<uint32_t, BlockSet> forward_succs;
+	for (auto block : func.blocks)
+	{
+		forward_succs[block];
+		if (!reachable.count(block))
+			continue;
+		for (auto next : cfg.get_succeeding_edges(block))
+		{
+			check(succs[block].count(next) != 0, "succeeding edge exists", block, next);
+			forward_succs[block].insert(next);
+		}
+		for (auto next : succs[block])
+			if (!forward_succs[block].count(next))
+				check(cfg.get_visit_order(next) >= cfg.get_visit_order(block), "left out edge is a back edge", block,
+				      next);
+	}
+
+	// Every block comes after its predecessors, back edges aside.
+	BlockSet ordered;
+	for (auto block : cfg.get_reverse_post_order())
+	{
+		for (auto pred : cfg.get_preceding_edges(block))
+			check(ordered.count(pred) != 0, "reverse post-order", pred, block);
+		check(ordered.insert(block).second, "reverse post-order visits once", block);
+	}
+	check(ordered == reachable, "reverse post-order covers reachable blocks", func.entry_block);
+	check(cfg.get_reverse_post_order().front() == func.entry_block, "reverse post-order starts at entry",
+	      func.entry_block);
+
+	for (auto a : func.blocks)
+	{
+		// walk_from follows the recorded edges only, and visits each block once.
+		multiset<uint32_t> walked;
+		cfg.walk_from(a, [&](uint32_t block) { walked.insert(block); });
+		auto expected_walk = reachable_from(a, forward_succs);
+		check(walked.size() == expected_walk.size() && BlockSet(begin(walked), end(walked)) == expected_walk,
+		      "walk_from", a);
+
+		// Dominance frontiers by definition, over every edge.
+		BlockSet frontier;
+		if (reachable.count(a))
+			for (auto block : reachable)
+				for (auto pred : preds[block])
+					if (dominates(a, pred) && !(a != block && dominates(a, block)))
+						frontier.insert(block);
+
+		multiset<uint32_t> got;
+		for (auto block : cfg.get_dominance_frontier(a))
+			got.insert(block);
+		check(got.size() == frontier.size() && BlockSet(begin(got), end(got)) == frontier, "dominance frontier",
+		      a);
+
+		auto itr = expected_frontiers.find(a);
+		if (itr != end(expected_frontiers))
+			check(frontier == itr->second, "expected dominance frontier", a);
+	}
+
+	return failures;
+}
+
+// Random control flow, including loops, irreducible regions and unreachable blocks.
+// As in SPIR-V, nothing branches back to the entry block.
+vector<Branch> random_branches(mt19937 &rnd, uint32_t count)
+{
+	vector<Branch> branches(count);
+	for (uint32_t i = 0; i + 1 < count; i++)
+	{
+		uint32_t any = 1 + rnd() % (count - 1);
+		uint32_t forward = i + 1 + rnd() % (count - i - 1);
+		uint32_t forward2 = i + 1 + rnd() % (count - i - 1);
+		uint32_t kind = rnd() % 10;
+		if (kind < 4)
+			branches[i].targets = { forward };
+		else if (kind < 5)
+			branches[i].targets = { any };
+		else if (kind < 9)
+			branches[i].targets = { forward, forward2 };
+		else
+			branches[i].targets = { any, forward };
+	}
+	return branches;
+}
+}
+
+int main()
+{
+	uint32_t failures = 0;
+
+	// entry -> header -> body -> continue -> header, header -> merge.
+	// The back edge puts the header in the frontier of the whole loop, itself included.
+	{
+		vector<Branch> loop(5);
+		loop[0].targets = { 1 };
+		loop[1].targets = { 2, 4 };
+		loop[2].targets = { 3 };
+		loop[3].targets = { 1 };
+		uint32_t header = FirstLabelId + 1;
+		uint32_t merge = FirstLabelId + 4;
+		map<uint32_t, BlockSet> expected = {
+			{ FirstLabelId, {} },
+			{ header, { header } },
+			{ FirstLabelId + 2, { header } },
+			{ FirstLabelId + 3, { header } },
+			{ merge, {} },
+		};
+		CFGTester tester(ModuleBuilder::build(loop));
+		failures += tester.run("loop", expected);
+	}
+
+	mt19937 rnd(1);
+	uint32_t tested = 0;
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		char name[32];
+		sprintf(name, "random %u", i);
+		CFGTester tester(ModuleBuilder::build(random_branches(rnd, 2 + i % 40)));
+		failures += tester.run(name);
+		if (tester.is_reducible())
+			tested++;
+	}
+
+	// Make sure the generator still produces enough control flow which is actually checked.
+	if (tested < 500)
+	{
+		fprintf(stderr, "Only %u random functions were reducible.\n", tested);
+		failures++;
+	}
+
+	if (failures)
+	{
+		fprintf(stderr, "%u CFG checks failed.\n", failures);
+		return 1;
+	}
+
+	printf("All CFG checks passed.\n");
+	return 0;
+}